@@ -46,12 +46,13 @@ private:
 	template <typename T> void append(T data) {
 		uint32_t s = sizeof(data);
 
-		if (size() < (wpos + s))
-			buf.resize(wpos + s);
+		grow(wpos + s);
 		memcpy(&buf[wpos], (uint8_t*)&data, s);
 
 		wpos += s;
 	}
+
+	void grow(uint32_t newSize); // Make sure the internal vector holds at least newSize bytes, growing its capacity geometrically
 	
 	template <typename T> void insert(T data, uint32_t index) {
 		if((index + sizeof(data)) > size())
@@ -72,6 +73,7 @@ public:
 	ByteBuffer* clone(); // Return a new instance of a ByteBuffer with the exact same contents and the same state (rpos, wpos)
 	bool equals(ByteBuffer* other); // Compare if the contents are equivalent
 	void resize(uint32_t newSize);
+	void reserve(uint32_t newCapacity); // Preallocate memory without changing the size or positions
 	uint32_t size(); // Size of internal vector
 
 	// Read
@@ -120,6 +122,10 @@ public:
 
 	void setWritePos(uint32_t w) { wpos = w; }
 	uint32_t getWritePos() const{ return wpos; }
+
+	// Direct access to the internal buffer, NULL if it's empty
+
+	uint8_t* getRawData() { return buf.empty() ? NULL : &buf[0]; }
 };
 
 #endif
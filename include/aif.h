@@ -34,8 +34,9 @@ private:
 	int status;
 
 	int ReadChunk();
+	void ConvertData(unsigned char *buf, int size);
 public:
-	aifFile(oamlFileCallbacks *cbs);
+	aifFile(oamlFileCallbacks2 *cbs);
 	~aifFile();
 
 	int GetFormat() const { return 0; }
@@ -44,9 +45,11 @@ public:
 	int GetBitsPerSample() const { return bitsPerSample; }
 	int GetBytesPerSample() const { return bitsPerSample / 8; }
 	int GetTotalSamples() const { return totalSamples; }
+	int GetPcmFormat() const;
 
 	int Open(const char *filename);
 	int Read(ByteBuffer *buffer, int size);
+	int Seek(unsigned int frame);
 
 	void WriteToFile(const char *filename, ByteBuffer *buffer, int channels, unsigned int sampleRate, int bytesPerSample);
 
@@ -23,15 +23,42 @@
 #ifndef __AUDIOFILE_H__
 #define __AUDIOFILE_H__
 
+// How the raw sample data of an uncompressed file is laid out. Read() hands
+// data out little endian, 8 bit unsigned and 32 bit as float, whatever the
+// file stores.
+enum {
+	OAML_PCM_NONE		= 0,
+	OAML_PCM_U8,
+	OAML_PCM_S8,
+	OAML_PCM_S16LE,
+	OAML_PCM_S16BE,
+	OAML_PCM_S24LE,
+	OAML_PCM_S24BE,
+	OAML_PCM_S32LE,
+	OAML_PCM_S32BE,
+	OAML_PCM_F32LE
+};
+
 class audioFile {
 protected:
-	oamlFileCallbacks *fcbs;
+	oamlFileCallbacks2 *fcbs;
 
 	void *fd;
 
+	// Set when the file could be memory mapped, dataOffset is where the sample data starts
+	oamlMappedFile *mapped;
+	unsigned int dataOffset;
+	unsigned int dataSize;
+
+	// Compressed file already in memory to decode from, instead of opening it
+	oamlMemoryFile *source;
+
+	bool MapFile();
+	size_t ReadBytes(void *ptr, size_t bytes);
+
 public:
 
-	audioFile(oamlFileCallbacks *cbs);
+	audioFile(oamlFileCallbacks2 *cbs);
 	virtual ~audioFile();
 
 	virtual int GetFormat() const = 0;
@@ -42,12 +69,29 @@ public:
 
 	virtual int Open(const char *filename) = 0;
 	virtual int Read(ByteBuffer *buffer, int size) = 0;
+	/** Moves the read position to frame (one sample per channel), returns 0 or -1 if it can't seek */
+	virtual int Seek(unsigned int) { return -1; }
 
 	virtual void WriteToFile(const char *filename, ByteBuffer *buffer, int channels, unsigned int sampleRate, int bytesPerSample) = 0;
 
 	virtual void Close() = 0;
 
-	oamlFileCallbacks* GetFileCallbacks() const { return fcbs; }
+	virtual int GetPcmFormat() const { return OAML_PCM_NONE; }
+
+	/** Decode from a copy of the file in memory instead of opening it, call it before Open(). Only compressed formats use it */
+	void SetSource(oamlMemoryFile *file);
+
+	/** True when the decoder produces float samples, which ReadFloat then hands out without conversion */
+	virtual bool IsFloat() const { return false; }
+	/** Decodes up to count interleaved samples into samples, returns how many were written or -1 on error */
+	virtual int ReadFloat(float *, int) { return -1; }
+
+	/** Sample data in place, only when the file is memory mapped and uncompressed, NULL otherwise */
+	const uint8_t* GetMappedData() const;
+	/** Hands the mapping over to the caller, which then has to delete it */
+	oamlMappedFile* DetachMapping();
+
+	oamlFileCallbacks2* GetFileCallbacks() const { return fcbs; }
 	void* GetFD() const { return fd; }
 };
 
@@ -64,6 +64,20 @@ typedef struct {
 	int    (*close) (void *fd);
 } oamlFileCallbacks;
 
+typedef struct {
+	void*  (*open)  (const char *filename);
+	size_t (*read)  (void *ptr, size_t size, size_t nitems, void *fd);
+	int    (*seek)  (void *fd, long offset, int whence);
+	long   (*tell)  (void *fd);
+	int    (*close) (void *fd);
+
+	/* Optional, any of these can be NULL */
+	long   (*size)  (void *fd);
+	const void* (*map) (void *fd, size_t *size);
+	void   (*unmap) (const void *ptr, size_t size);
+	size_t (*readInto) (void *fd, void *buffer, size_t bytes);
+} oamlFileCallbacks2;
+
 
 #ifndef __cplusplus
 
@@ -80,6 +94,7 @@ oamlRC oamlInitAudioDevice(int sampleRate, int channels);
 oamlRC oamlInit(const char *defsFilename);
 oamlRC oamlReadDefsFile(const char *defsFilename);
 oamlRC oamlInitString(const char *defs);
+oamlRC oamlCompileDefs(const char *defsFilename, const char *outFilename);
 void oamlSetAudioFormat(int sampleRate, int channels, int bytesPerSample, bool floatBuffer);
 oamlRC oamlPlayTrack(const char *name);
 oamlRC oamlPlayTrackWithStringRandom(const char *str);
@@ -88,6 +103,24 @@ oamlRC oamlPlayTrackByGroupAndSubgroupRandom(const char *group, const char *subg
 oamlRC oamlPlaySfx(const char *name);
 oamlRC oamlPlaySfxEx(const char *name, float vol, float pan);
 oamlRC oamlPlaySfx2d(const char *name, int x, int y, int width, int height);
+int oamlGetTrackHandle(const char *name);
+int oamlGetSfxHandle(const char *name);
+int oamlGetLayerHandle(const char *layer);
+oamlRC oamlPlayTrackHandle(int handle);
+oamlRC oamlPlaySfxHandle(int handle);
+oamlRC oamlPlaySfxExHandle(int handle, float vol, float pan);
+oamlRC oamlLoadTrackHandle(int handle);
+bool oamlIsTrackPlayingHandle(int handle);
+void oamlSetLayerGainHandle(int handle, float gain);
+oamlRC oamlLoadTrackAsync(const char *name);
+float oamlLoadTrackProgress(const char *name);
+void oamlSetLoaderThreads(int count);
+oamlRC oamlPinTrack(const char *name);
+oamlRC oamlUnpinTrack(const char *name);
+void oamlSetCacheBudget(size_t bytes);
+size_t oamlGetCacheMemoryUsage();
+void oamlSetStreamingThreshold(size_t bytes);
+void oamlSetCompressedPlayback(bool enable);
 bool oamlIsTrackPlaying(const char *name);
 bool oamlIsPlaying();
 void oamlStopPlaying();
@@ -106,6 +139,7 @@ void oamlUpdate();
 void SetDebugClipping(bool option);
 void SetWriteAudioAtShutdown(bool option);
 void oamlSetFileCallbacks(oamlFileCallbacks *cbs);
+void oamlSetFileCallbacks2(oamlFileCallbacks2 *cbs);
 void oamlEnableDynamicCompressor(bool enable, double threshold, double ratio);
 const char* oamlGetDefsFile();
 const char* oamlGetPlayingInfo();
@@ -206,6 +240,12 @@ public:
 	 */
 	oamlRC InitString(const char *defs);
 
+	/** Load 'oaml.defs' like Init does and save it compiled into outFilename. Init and ReadDefsFile
+	 *  load compiled files directly, without parsing xml or probing the audio files headers
+	 *  @return returns OAML_OK on success
+	 */
+	oamlRC CompileDefs(const char *defsFilename, const char *outFilename);
+
 	/** Initialize the audio device through RtAudio
 	 *  @return returns OAML_OK on success
 	 */
@@ -246,15 +286,58 @@ public:
 	oamlRC PlaySfxEx(const char *name, float vol, float pan);
 	oamlRC PlaySfx2d(const char *name, int x, int y, int width, int height);
 
+	/** Get a handle for a track, sfx or layer, the calls taking it skip looking the name up every time.
+	 *  Handles stay valid until the definitions are loaded again
+	 *  @return returns the handle, or -1 if there's nothing with that name
+	 */
+	int GetTrackHandle(const char *name);
+	int GetSfxHandle(const char *name);
+	int GetLayerHandle(const char *layer);
+
+	/** Same as PlayTrack, PlaySfxEx, LoadTrack, IsTrackPlaying and SetLayerGain with a handle instead of a name */
+	oamlRC PlayTrackHandle(int handle);
+	oamlRC PlaySfxHandle(int handle, float vol = 1.f, float pan = 0.f);
+	oamlRC LoadTrackHandle(int handle);
+	bool IsTrackPlayingHandle(int handle);
+	void SetLayerGainHandle(int handle, float gain);
+
 	/** Load a track into memory cache (blocking)
 	 */
 	oamlRC LoadTrack(const char *name);
 
-	/** Load a track into memory cache (non-blocking)
+	/** Queue a track to be loaded into memory cache by the loader threads (non-blocking)
+	 *  @return returns OAML_OK on success
+	 */
+	oamlRC LoadTrackAsync(const char *name);
+
+	/** Load a track into memory cache (non-blocking), queues the track if it isn't loading yet
 	 *  @return returns 0.f to 1.f or -1.f on error
 	 */
 	float LoadTrackProgress(const char *name);
 
+	/** Set the number of background threads used to load tracks */
+	void SetLoaderThreads(int count);
+
+	/** Keep the decoded audio of a track in memory regardless of the cache budget
+	 *  @return returns OAML_OK on success
+	 */
+	oamlRC PinTrack(const char *name);
+	oamlRC UnpinTrack(const char *name);
+
+	/** Set how many bytes of decoded audio are kept in memory for tracks that aren't playing */
+	void SetCacheBudget(size_t bytes);
+
+	/** Get the number of bytes of decoded audio currently in memory */
+	size_t GetCacheMemoryUsage();
+
+	/** Stream files whose decoded size is over this many bytes instead of keeping them in memory, 0 disables it */
+	void SetStreamingThreshold(size_t bytes);
+
+	/** Keep compressed files (ogg) in memory as they are and decode them while they play, instead of decoding them whole.
+	 *  Uses a fraction of the memory for some extra cpu, only applies to files not opened yet
+	 */
+	void SetCompressedPlayback(bool enable);
+
 	/** Stop playing any track currently playing */
 	void StopPlaying();
 
@@ -294,7 +377,10 @@ public:
 	/** Set random chance (0 - 100) of a layer */
 	void SetLayerRandomChance(const char *layer, int rhandomChance);
 
-	/** Main function to call form the internal game audio manager */
+	/** Main function to call form the internal game audio manager. Playing, stopping, conditions and layer
+	 *  changes are queued and applied at the start of the next call. The queue holds 1024 calls without
+	 *  locking, past that they're still kept, but behind a mutex and allocating, until MixToBuffer catches up
+	 */
 	void MixToBuffer(void *buffer, int size);
 
 	/** Update */
@@ -310,6 +396,12 @@ public:
 	/** Set file handling callbacks */
 	void SetFileCallbacks(oamlFileCallbacks *cbs);
 
+	/** Set file handling callbacks with the optional size, map/unmap and readInto hooks
+	 *  map returns the whole file in memory so audio and definitions can be used in place, it may be
+	 *  unmapped after the file was closed. readInto reads up to 'bytes' straight into the caller's buffer
+	 */
+	void SetFileCallbacks(oamlFileCallbacks2 *cbs);
+
 	/** Returns the 'oaml.defs' filename that was used for initialization */
 	const char* GetDefsFile();
 
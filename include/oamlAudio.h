@@ -28,9 +28,10 @@ class ByteBuffer;
 class oamlAudio {
 private:
 	bool verbose;
-	oamlFileCallbacks *fcbs;
+	oamlFileCallbacks2 *fcbs;
+	oamlSampleCache *cache;
 
-	std::vector<oamlAudioFile> files;
+	std::vector<oamlAudioFile*> files;
 	std::string name;
 	int type;
 	int bars;
@@ -40,7 +41,6 @@ private:
 	unsigned int samplesPerSec;
 	unsigned int samplesToEnd;
 	unsigned int totalSamples;
-	unsigned int filesSamples;
 	unsigned int channelCount;
 
 	float bpm;
@@ -63,13 +63,23 @@ private:
 	int condType;
 	int condValue;
 	int condValue2;
+	// Condition compiled to the inclusive range of values that make it true
+	int condMin;
+	int condMax;
 
 	bool pickable;
 
+	std::vector<float> buffer;
+
 	void UpdateSamplesToEnd();
+	void CompileCondition();
+
+	void ReadFloats(float *samples, unsigned int count);
+	void ReadFloats(float *samples, unsigned int count, unsigned int pos);
+	void ConvertChannels(const float *src, float *dst, int frames, int channels);
 
 public:
-	oamlAudio(oamlFileCallbacks *cbs, bool _verbose);
+	oamlAudio(oamlFileCallbacks2 *cbs, oamlSampleCache *_cache, bool _verbose);
 	~oamlAudio();
 
 	void SetName(std::string _name) { name = _name; }
@@ -87,25 +97,28 @@ public:
 	void SetXFadeOut(unsigned int audioXFadeOut) { xfadeOut = audioXFadeOut; }
 
 	void SetCondId(int audioCondId) { condId = audioCondId; }
-	void SetCondType(int audioCondType) { condType = audioCondType; }
-	void SetCondValue(int audioCondValue) { condValue = audioCondValue; }
-	void SetCondValue2(int audioCondValue2) { condValue2 = audioCondValue2; }
+	void SetCondType(int audioCondType) { condType = audioCondType; CompileCondition(); }
+	void SetCondValue(int audioCondValue) { condValue = audioCondValue; CompileCondition(); }
+	void SetCondValue2(int audioCondValue2) { condValue2 = audioCondValue2; CompileCondition(); }
 
 	void SetCondition(int id, int type, int value, int value2 = 0);
-	bool TestCondition(int id, int value);
+	bool TestCondition(int id, int value) const { return id == condId && value >= condMin && value <= condMax; }
 	bool HasCondition(int id) { return id == condId; }
 
 	bool HasFinished();
 	bool HasFinishedTail(unsigned int pos);
+	unsigned int GetFramesToEnd();
+	unsigned int GetFramesTo(unsigned int pos);
+	unsigned int GetFramesToEndTail(unsigned int pos);
 
-	oamlRC Open();
-	oamlRC Load();
-	int LoadProgress();
-	float ReadFloat();
-	float ReadFloat(unsigned int pos);
+	/** Opens every file so the audio can be played, on the calling thread. Undone by Unprepare() unless it fails */
+	oamlRC Prepare();
+	void Unprepare();
+	/** Starts playing a prepared audio from the beginning */
+	void Open();
 
-	void ReadSamples(float *samples, int channels);
-	unsigned int ReadSamples(float *samples, int channels, unsigned int pos);
+	void ReadSamples(float *samples, int frames, int channels);
+	unsigned int ReadSamples(float *samples, int frames, int channels, unsigned int pos);
 
 	void DoFadeIn(int msec);
 	void DoFadeOut(int msec);
@@ -113,11 +126,12 @@ public:
 	void ReadInfo(oamlAudioInfo *info);
 
 	void GetAudioFileList(std::vector<std::string>& list);
-	bool HasAudioFile(std::string filename);
-	void RemoveAudioFile(std::string filename);
-	oamlAudioFile *GetAudioFile(std::string filename);
+	void GetAudioFiles(std::vector<oamlAudioFile*>& list);
+	bool HasAudioFile(const std::string& filename);
+	void RemoveAudioFile(const std::string& filename);
+	oamlAudioFile *GetAudioFile(const std::string& filename);
 
-	void AddAudioFile(std::string filename, std::string layer = "", int randomChance = -1);
+	void AddAudioFile(std::string filename, std::string layer = "", int randomChance = -1, bool stream = false);
 	std::string GetName() const { return name; }
 	float GetVolume() const { return volume; }
 	float GetBPM() const { return bpm; }
@@ -137,13 +151,13 @@ public:
 	unsigned int GetXFadeOut() const { return xfadeOut; }
 
 	unsigned int GetBarsSamples(int bars);
+	unsigned int GetNextBarsPos(int bars);
 	unsigned int GetSamplesCount() const { return samplesCount; }
-	unsigned int GetFilesSamples();
 
 	void SetPickable(bool value) { pickable = value; }
 	bool IsPickable() const { return pickable; }
 
-	void FreeMemory();
+	void Release();
 };
 
 #endif
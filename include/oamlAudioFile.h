@@ -23,60 +23,74 @@
 #ifndef __OAMLAUDIOFILE_H__
 #define __OAMLAUDIOFILE_H__
 
-class ByteBuffer;
-
 class oamlAudioFile {
 private:
 	bool verbose;
-	oamlFileCallbacks *fcbs;
+	oamlSampleCache *cache;
 
-	ByteBuffer buffer;
-	audioFile *handle;
+	oamlSample *sample;
 	std::string filename;
 	std::string layer;
 	int randomChance;
 	float gain;
 
-	unsigned int bytesPerSample;
-	unsigned int samplesPerSec;
-	unsigned int totalSamples;
-	unsigned int channelCount;
 	unsigned int samplesToEnd;
 
 	bool chance;
 	bool lastChance;
+	bool pinned;
+
+	// Plays that prepared this file and haven't given it back yet, each one counts as a user of the sample
+	std::atomic<int> prepared;
 
-	oamlRC OpenFile();
+	// Streamed files get one stream per read position, two cover a loop restarting while its tail plays.
+	// They're created by Prepare() and only read from the mixer, which never creates or frees one
+	std::atomic<oamlStream*> streams[2];
+	unsigned int streamReads[2];
+	unsigned int readsCount;
 
-	int Read();
-	int Read32(unsigned int pos);
+	oamlStream* GetStream(unsigned int pos);
+	void ReadStream(float *samples, unsigned int pos, unsigned int count);
+	void OpenStreams();
+	void CloseStreams();
 
 public:
-	oamlAudioFile(std::string _filename, oamlFileCallbacks *cbs, bool _verbose);
+	oamlAudioFile(std::string _filename, oamlFileCallbacks2 *cbs, oamlSampleCache *_cache, bool _verbose);
 	~oamlAudioFile();
 
-	void SetFilename(std::string _filename) { filename = _filename; }
 	void SetLayer(std::string _layer) { layer = _layer; }
 	void SetRandomChance(int _randomChance) { randomChance = _randomChance; }
 	void SetGain(float _gain) { gain = _gain; }
+	void SetStreaming() { sample->SetStreaming(); }
 
 	std::string GetFilename() const { return filename; }
 	const char *GetFilenameStr() const { return filename.c_str(); }
 	std::string GetLayer() const { return layer; }
 	int GetRandomChance() { return randomChance; }
 	float GetGain() { return gain; }
+	bool IsStreamRequested() const { return sample->IsStreamRequested(); }
 
-	oamlRC Open();
+	/** Opens the sample so it can be played, called from the game thread before the play is queued */
+	oamlRC Prepare();
+	/** Undoes a Prepare(), even a failed one. Never blocks, so it's fine on the audio thread */
+	void Unprepare();
+	/** Starts a play of a prepared file, on the audio thread */
+	void Open();
 	oamlRC Load();
-	int LoadProgress();
-	float ReadFloat(unsigned int pos, bool isTail = false);
+	float LoadProgress();
+	bool IsLoaded();
+	void ReadFloats(float *samples, unsigned int pos, unsigned int count, bool isTail = false);
 
-	unsigned int GetChannels() const { return channelCount; }
-	unsigned int GetTotalSamples() const { return totalSamples; }
-	unsigned int GetSamplesPerSec() const { return samplesPerSec; }
+	unsigned int GetChannels() const { return sample->GetChannels(); }
+	unsigned int GetTotalSamples() const { return sample->GetTotalSamples(); }
+	unsigned int GetSamplesPerSec() const { return sample->GetSamplesPerSec(); }
 	void SetSamplesToEnd(unsigned int samples) { samplesToEnd = samples; }
 
-	void FreeMemory();
+	void SetPinned(bool pin);
+
+	// Keeps the sample from being evicted for a while, on top of SetPinned
+	void HoldSample() { sample->Pin(); }
+	void ReleaseSample() { sample->Unpin(); }
 };
 
 #endif
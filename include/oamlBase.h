@@ -45,12 +45,26 @@ private:
 	std::vector<oamlTrack*> sfxTracks;
 	std::vector<oamlLayer*> layers;
 
+	// Name lookups, updated as tracks and layers are added, renamed or removed
+	std::unordered_map<std::string, oamlTrack*> trackIndex;
+	std::unordered_map<std::string, oamlLayer*> layerIndex;
+
+	// Handles given out by Get*Handle() index these, entries are cleared when what they point to is removed
+	std::vector<oamlTrack*> trackHandles;
+	std::vector< std::pair<oamlTrack*, oamlAudio*> > sfxHandles;
+
 	float bpm;
 	int beatsPerBar;
 
 	oamlTrack *curTrack;
 
 	ByteBuffer *fullBuffer;
+	std::vector<float> mixBuffer;
+
+	// Declared before the loader so it's destroyed after the loader threads are stopped
+	oamlSampleCache samples;
+	oamlLoader loader;
+	oamlCommandQueue commands;
 
 #ifdef __HAVE_RTAUDIO
 	RtAudio *rtAudio;
@@ -61,12 +75,18 @@ private:
 	int bytesPerSample;
 	bool floatBuffer;
 
+	// Mixing stage specialized for the current output format, see SelectMixKernel(). Set from the game
+	// thread while the mixer may be running, a plain function pointer so the atomic is lock free
+	typedef bool (*MixKernel)(oamlBase *base, void *buffer, int size);
+	std::atomic<MixKernel> mixKernel;
+
 	int tension;
 	uint64_t tensionMs;
 	float volume;
 	bool pause;
 
-	oamlFileCallbacks *fcbs;
+	oamlFileCallbacks2 *fcbs;
+	oamlFileCallbacks2 userCbs;
 
 	uint64_t timeMs;
 
@@ -76,29 +96,52 @@ private:
 
 	void Clear();
 
+	void DropCommands(oamlTrack *track, oamlAudio *audio);
+	void UnprepareCommand(oamlCommand& cmd);
+	void ProcessCommands();
+	void RunCommand(oamlCommand& cmd);
+
+	oamlRC QueuePlayTrack(oamlTrack *track);
+	oamlRC QueuePlaySfx(oamlTrack *track, oamlAudio *audio, float vol, float pan);
 	oamlRC PlayTrackId(int id);
-	bool IsTrackPlayingId(int id);
+	oamlRC LoadTrackFiles(oamlTrack *track);
+
+	oamlTrack* GetTrackByHandle(int handle);
+	void ReleaseHandles(oamlTrack *track, oamlAudio *audio);
 
 	void ShowPlayingTracks();
 	oamlRC ReadAudioDefs(tinyxml2::XMLElement *el, oamlTrack *track);
 	oamlRC ReadTrackDefs(tinyxml2::XMLElement *el);
 	oamlRC ReadDefs(const char *buf, int size);
+	oamlRC ReadBinaryDefs(const char *buf, int size);
+	oamlRC WriteBinaryDefs(const char *filename);
 	void ReadInternalDefs(const char *filaname);
 
 	int ReadSample(void *buffer, int index);
-	void WriteSample(void *buffer, int index, int sample);
 
 	bool IsAudioFormatSupported();
 
-	void AddLayer(std::string layer);
-	int GetLayerId(std::string layer);
-	oamlLayer *GetLayer(std::string layer);
+	void MixTracks(int size, int frames, int mixChannels);
+	template <int CHANNELS, bool COMPRESSOR, class OUTPUT>
+	static bool MixOutput(oamlBase *base, void *buffer, int size);
+	template <int CHANNELS, bool COMPRESSOR>
+	MixKernel GetMixKernel();
+	void SelectMixKernel();
+
+	void AddLayer(const std::string& layer);
+	int GetLayerId(const std::string& layer);
+	oamlLayer *GetLayer(const std::string& layer);
+	void IndexLayers();
 
 	void UpdateTension(uint64_t ms);
 
-	oamlTrack* GetTrack(std::string name);
-	oamlAudio* GetAudio(std::string trackName, std::string audioName);
-	oamlAudioFile* GetAudioFile(std::string trackName, std::string audioName, std::string filename);
+	oamlRC SetTrackPinned(const char *name, bool pin);
+
+	void IndexTrack(oamlTrack *track);
+	void IndexTracks();
+	oamlTrack* GetTrack(const std::string& name);
+	oamlAudio* GetAudio(const std::string& trackName, const std::string& audioName);
+	oamlAudioFile* GetAudioFile(const std::string& trackName, const std::string& audioName, const std::string& filename);
 
 public:
 	oamlBase();
@@ -110,9 +153,10 @@ public:
 	oamlRC Init(const char *defsFilename);
 	oamlRC ReadDefsFile(const char *defsFilename);
 	oamlRC InitString(const char *defs);
+	oamlRC CompileDefs(const char *defsFilename, const char *outFilename);
 	void Shutdown();
 
-	void SetVerbose(bool option) { verbose = option; }
+	void SetVerbose(bool option) { verbose = option; loader.SetVerbose(option); }
 	void SetDebugClipping(bool option) { debugClipping = option; }
 	void SetWriteAudioAtShutdown(bool option) { writeAudioAtShutdown = option; }
 
@@ -128,8 +172,26 @@ public:
 	oamlRC PlaySfxEx(const char *name, float vol, float pan);
 	oamlRC PlaySfx2d(const char *name, int x, int y, int width, int height);
 
+	int GetTrackHandle(const char *name);
+	int GetSfxHandle(const char *name);
+	int GetLayerHandle(const char *layer);
+	oamlRC PlayTrackHandle(int handle);
+	oamlRC PlaySfxHandle(int handle, float vol, float pan);
+	oamlRC LoadTrackHandle(int handle);
+	bool IsTrackPlayingHandle(int handle);
+	void SetLayerGainHandle(int handle, float gain);
+
 	oamlRC LoadTrack(const char *name);
+	oamlRC LoadTrackAsync(const char *name);
 	float LoadTrackProgress(const char *name);
+	void SetLoaderThreads(int count);
+
+	oamlRC PinTrack(const char *name);
+	oamlRC UnpinTrack(const char *name);
+	void SetCacheBudget(size_t bytes);
+	size_t GetCacheMemoryUsage();
+	void SetStreamingThreshold(size_t bytes);
+	void SetCompressedPlayback(bool enable);
 
 	void StopPlaying();
 	void Pause();
@@ -155,9 +217,8 @@ public:
 
 	void Update();
 
-	int SafeAdd(int sample1, int sample2);
-
 	void SetFileCallbacks(oamlFileCallbacks *cbs);
+	void SetFileCallbacks(oamlFileCallbacks2 *cbs);
 
 	void EnableDynamicCompressor(bool enable, double thresholdDb, double ratio);
 
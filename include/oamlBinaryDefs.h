@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLBINARYDEFS_H__
+#define __OAMLBINARYDEFS_H__
+
+#define OAML_BINARY_DEFS_MAGIC		"OAMB"
+#define OAML_BINARY_DEFS_VERSION	2
+
+//
+// Compact binary encoding of oaml.defs, written by oamlBase::CompileDefs().
+//
+// The file is a 4 byte magic and a version, followed by a table with every
+// distinct string and then the project data itself, where strings are
+// stored as indices into the table. Integers and floats are 32 bits little
+// endian, so a compiled file can be read straight from a mapping.
+//
+
+class oamlBinaryDefs {
+private:
+	// Writing
+	ByteBuffer data;
+	std::vector<std::string> strings;
+	std::map<std::string, uint32_t> stringIds;
+
+	// Reading
+	const uint8_t *buf;
+	size_t size;
+	size_t pos;
+	bool error;
+	std::vector<size_t> stringOffsets;
+
+	void PutUInt(ByteBuffer& out, uint32_t value);
+	const uint8_t *Fetch(size_t bytes);
+
+public:
+	oamlBinaryDefs();
+	~oamlBinaryDefs();
+
+	static bool IsBinaryDefs(const char *buffer, size_t bufferSize);
+
+	void PutInt(int value);
+	void PutFloat(float value);
+	void PutString(const std::string& str);
+	oamlRC Save(const char *filename);
+
+	oamlRC Open(const char *buffer, size_t bufferSize);
+	int GetInt();
+	float GetFloat();
+	std::string GetString();
+	bool HasError() const { return error; }
+};
+
+#endif /* __OAMLBINARYDEFS_H__ */
@@ -0,0 +1,93 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLCOMMANDQUEUE_H__
+#define __OAMLCOMMANDQUEUE_H__
+
+class oamlTrack;
+class oamlAudio;
+class oamlLayer;
+
+typedef enum {
+	OAML_COMMAND_PLAY_TRACK			= 0,
+	OAML_COMMAND_STOP_PLAYING		= 1,
+	OAML_COMMAND_PLAY_SFX			= 2,
+	OAML_COMMAND_SET_CONDITION		= 3,
+	OAML_COMMAND_SET_LAYER_GAIN		= 4,
+	OAML_COMMAND_SET_LAYER_RANDOM_CHANCE	= 5
+} oamlCommandType;
+
+typedef struct {
+	oamlCommandType type;
+	oamlTrack *track;
+	oamlAudio *audio;
+	oamlLayer *layer;
+	int id;
+	int value;
+	float vol;
+	float pan;
+} oamlCommand;
+
+//
+// Queue used to hand API calls over to the audio thread. Any thread can
+// push, the mixer pops everything pending at the start of each block.
+// Pushing never fails: commands go through a lock-free ring, based on
+// Dmitry Vyukov's bounded MPMC queue, where every cell keeps a sequence
+// number that tells producers and consumers whose turn it is. When the
+// mixer falls that far behind the rest wait in an overflow list behind a
+// mutex, until it catches up.
+//
+
+class oamlCommandQueue {
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		oamlCommand cmd;
+	};
+
+	Cell *cells;
+	size_t mask;
+
+	std::atomic<size_t> enqueuePos;
+	std::atomic<size_t> dequeuePos;
+
+	// Once anything is in the overflow every push goes there too, so a thread's commands stay in order
+	std::mutex overflowMutex;
+	std::vector<oamlCommand> overflow;
+	size_t overflowPos;
+	std::atomic<bool> overflowed;
+
+	bool PushRing(const oamlCommand& cmd);
+	bool PopRing(oamlCommand& cmd);
+
+public:
+	/** Size must be a power of two, it's how many commands fit before they spill into the overflow */
+	oamlCommandQueue(size_t size = 1024);
+	~oamlCommandQueue();
+
+	void Push(const oamlCommand& cmd);
+	bool Pop(oamlCommand& cmd);
+
+	void Clear();
+};
+
+#endif /* __OAMLCOMMANDQUEUE_H__ */
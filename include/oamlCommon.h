@@ -24,6 +24,16 @@
 #define __OAMLCOMMON_H__
 
 #include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits.h>
+#include <map>
+#include <math.h>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
 
 //
 // Definitions
@@ -50,6 +60,23 @@
 #endif
 
 
+// Instruction sets the mixing and resampling kernels have paths for
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OAML_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define OAML_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OAML_NEON
+#include <arm_neon.h>
+#endif
+
+
 #ifdef DEBUG
 
 #ifdef _MSC_VER
@@ -68,19 +95,32 @@
 #include "oaml.h"
 #include "gettime.h"
 #include "ByteBuffer.h"
+#include "oamlMappedFile.h"
+#include "oamlMemoryFile.h"
+#include "oamlBinaryDefs.h"
 #include "audioFile.h"
 #include "aif.h"
 #ifdef __HAVE_OGG
 #include "ogg.h"
 #endif
+#include "qoa.h"
 #include "wav.h"
 #include "oamlLayer.h"
+#include "oamlPcmBuffer.h"
+#include "oamlResampler.h"
+#include "oamlStream.h"
+#include "oamlStreamer.h"
+#include "oamlSample.h"
+#include "oamlSampleCache.h"
 #include "oamlAudioFile.h"
 #include "oamlAudio.h"
 #include "oamlTrack.h"
 #include "oamlMusicTrack.h"
 #include "oamlSfxTrack.h"
+#include "oamlLoader.h"
+#include "oamlCommandQueue.h"
 #include "oamlCompressor.h"
+#include "oamlConvert.h"
 #include "oamlBase.h"
 #include "oamlUtil.h"
 
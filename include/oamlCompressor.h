@@ -36,6 +36,33 @@ private:
 	double rel;
 	double env;
 
+	template <int CHANNELS>
+	void ProcessFrame(float *data) {
+		float peak = 0;
+		for (int i=0; i<CHANNELS; i++) {
+			float val = fabs(data[i]);
+			if (val > peak) peak = val;
+		}
+
+		if (peak > env) {
+			env = att * (env - peak) + peak;
+		} else {
+			env = rel * (env - peak) + peak;
+		}
+
+		float gain;
+		if (env > threshold) {
+			gain = float(threshold / (1.0 + ratio * ((env / threshold) - 1.0)));
+		} else {
+			gain = float(threshold);
+		}
+
+		gain = gain * 0.5f + 0.5f;
+		for (int i=0; i<CHANNELS; i++) {
+			data[i]*= gain;
+		}
+	}
+
 public:
 	oamlCompressor();
 	~oamlCompressor();
@@ -45,6 +72,13 @@ public:
 
 	void SetAudioFormat(int channels, int sampleRate);
 	void ProcessData(float *data);
+
+	template <int CHANNELS>
+	void ProcessBlock(float *data, int frames) {
+		for (int i=0; i<frames; i++) {
+			ProcessFrame<CHANNELS>(data + i*CHANNELS);
+		}
+	}
 };
 
 #endif
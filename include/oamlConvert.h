@@ -0,0 +1,247 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLCONVERT_H__
+#define __OAMLCONVERT_H__
+
+//
+// Kernels that apply the master volume to a block of mixed float samples,
+// convert them to the output format and add them into the output buffer
+// with saturation. They return true if any sample clipped.
+//
+// They're functors so oamlBase::MixOutput() gets one inlined for each
+// output format.
+//
+
+// Samples are converted to 24bit first, same as __oamlFloatToInteger24 but clamped instead of wrapping around
+static const float OAML_S24_MIN = -8388608.f;
+static const float OAML_S24_MAX = 8388607.f;
+static const float OAML_S24_SCALE = 8388608.f;
+
+static inline int __oamlFloatToS24(float f, float scale) {
+	float x = f * scale;
+	if (x < OAML_S24_MIN) x = OAML_S24_MIN;
+	if (x > OAML_S24_MAX) x = OAML_S24_MAX;
+	return (int)x;
+}
+
+struct oamlMixOutputFloat {
+	bool operator()(void *buffer, const float *samples, int count, float volume) const {
+		float *out = (float *)buffer;
+		int i = 0;
+
+#if defined(OAML_AVX2)
+		__m256 vol8 = _mm256_set1_ps(volume);
+		for (; i+8<=count; i+= 8) {
+			__m256 s = _mm256_mul_ps(_mm256_loadu_ps(samples+i), vol8);
+			_mm256_storeu_ps(out+i, _mm256_add_ps(_mm256_loadu_ps(out+i), s));
+		}
+#endif
+
+#if defined(OAML_SSE2)
+		__m128 vol4 = _mm_set1_ps(volume);
+		for (; i+4<=count; i+= 4) {
+			__m128 s = _mm_mul_ps(_mm_loadu_ps(samples+i), vol4);
+			_mm_storeu_ps(out+i, _mm_add_ps(_mm_loadu_ps(out+i), s));
+		}
+#elif defined(OAML_NEON)
+		float32x4_t vol4 = vdupq_n_f32(volume);
+		for (; i+4<=count; i+= 4) {
+			float32x4_t s = vmulq_f32(vld1q_f32(samples+i), vol4);
+			vst1q_f32(out+i, vaddq_f32(vld1q_f32(out+i), s));
+		}
+#endif
+
+		for (; i<count; i++) {
+			out[i]+= samples[i] * volume;
+		}
+
+		// Float buffers are allowed to go over 1.0
+		return false;
+	}
+};
+
+struct oamlMixOutput8 {
+	bool operator()(void *buffer, const float *samples, int count, float volume) const {
+		// 8bit output is unsigned
+		uint8_t *out = (uint8_t *)buffer;
+		float scale = volume * OAML_S24_SCALE;
+		bool clipping = false;
+
+		for (int i=0; i<count; i++) {
+			int sample = (int)out[i] + (__oamlFloatToS24(samples[i], scale) >> 16);
+			if (sample < 0) { sample = 0; clipping = true; }
+			if (sample > 255) { sample = 255; clipping = true; }
+			out[i] = (uint8_t)sample;
+		}
+
+		return clipping;
+	}
+};
+
+struct oamlMixOutput16 {
+	bool operator()(void *buffer, const float *samples, int count, float volume) const {
+		int16_t *out = (int16_t *)buffer;
+		float scale = volume * OAML_S24_SCALE;
+		bool clipping = false;
+		int i = 0;
+
+#if defined(OAML_AVX2)
+		{
+			__m256 scale8 = _mm256_set1_ps(scale);
+			__m256 min8 = _mm256_set1_ps(OAML_S24_MIN);
+			__m256 max8 = _mm256_set1_ps(OAML_S24_MAX);
+			__m256i lo16 = _mm256_set1_epi32(-32768);
+			__m256i hi16 = _mm256_set1_epi32(32767);
+			__m256i clip = _mm256_setzero_si256();
+
+			for (; i+16<=count; i+= 16) {
+				__m256 f0 = _mm256_mul_ps(_mm256_loadu_ps(samples+i), scale8);
+				__m256 f1 = _mm256_mul_ps(_mm256_loadu_ps(samples+i+8), scale8);
+				__m256i s0 = _mm256_srai_epi32(_mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(f0, min8), max8)), 8);
+				__m256i s1 = _mm256_srai_epi32(_mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(f1, min8), max8)), 8);
+
+				s0 = _mm256_add_epi32(s0, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(out+i))));
+				s1 = _mm256_add_epi32(s1, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(out+i+8))));
+
+				clip = _mm256_or_si256(clip, _mm256_or_si256(_mm256_cmpgt_epi32(s0, hi16), _mm256_cmpgt_epi32(lo16, s0)));
+				clip = _mm256_or_si256(clip, _mm256_or_si256(_mm256_cmpgt_epi32(s1, hi16), _mm256_cmpgt_epi32(lo16, s1)));
+
+				// packs works per 128bit lane, put the quarters back in order
+				__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(s0, s1), 0xD8);
+				_mm256_storeu_si256((__m256i*)(out+i), packed);
+			}
+
+			if (_mm256_movemask_epi8(clip)) clipping = true;
+		}
+#endif
+
+#if defined(OAML_SSE2)
+		{
+			__m128 scale4 = _mm_set1_ps(scale);
+			__m128 min4 = _mm_set1_ps(OAML_S24_MIN);
+			__m128 max4 = _mm_set1_ps(OAML_S24_MAX);
+			__m128i lo16 = _mm_set1_epi32(-32768);
+			__m128i hi16 = _mm_set1_epi32(32767);
+			__m128i clip = _mm_setzero_si128();
+
+			for (; i+8<=count; i+= 8) {
+				__m128 f0 = _mm_mul_ps(_mm_loadu_ps(samples+i), scale4);
+				__m128 f1 = _mm_mul_ps(_mm_loadu_ps(samples+i+4), scale4);
+				__m128i s0 = _mm_srai_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(f0, min4), max4)), 8);
+				__m128i s1 = _mm_srai_epi32(_mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(f1, min4), max4)), 8);
+
+				// Sign extend the current buffer contents to 32bit
+				__m128i cur = _mm_loadu_si128((const __m128i*)(out+i));
+				s0 = _mm_add_epi32(s0, _mm_srai_epi32(_mm_unpacklo_epi16(cur, cur), 16));
+				s1 = _mm_add_epi32(s1, _mm_srai_epi32(_mm_unpackhi_epi16(cur, cur), 16));
+
+				clip = _mm_or_si128(clip, _mm_or_si128(_mm_cmpgt_epi32(s0, hi16), _mm_cmplt_epi32(s0, lo16)));
+				clip = _mm_or_si128(clip, _mm_or_si128(_mm_cmpgt_epi32(s1, hi16), _mm_cmplt_epi32(s1, lo16)));
+
+				_mm_storeu_si128((__m128i*)(out+i), _mm_packs_epi32(s0, s1));
+			}
+
+			if (_mm_movemask_epi8(clip)) clipping = true;
+		}
+#elif defined(OAML_NEON)
+		{
+			float32x4_t scale4 = vdupq_n_f32(scale);
+			float32x4_t min4 = vdupq_n_f32(OAML_S24_MIN);
+			float32x4_t max4 = vdupq_n_f32(OAML_S24_MAX);
+			uint32x4_t clip = vdupq_n_u32(0);
+
+			for (; i+8<=count; i+= 8) {
+				float32x4_t f0 = vmulq_f32(vld1q_f32(samples+i), scale4);
+				float32x4_t f1 = vmulq_f32(vld1q_f32(samples+i+4), scale4);
+				int32x4_t s0 = vshrq_n_s32(vcvtq_s32_f32(vminq_f32(vmaxq_f32(f0, min4), max4)), 8);
+				int32x4_t s1 = vshrq_n_s32(vcvtq_s32_f32(vminq_f32(vmaxq_f32(f1, min4), max4)), 8);
+
+				int16x8_t cur = vld1q_s16(out+i);
+				s0 = vaddq_s32(s0, vmovl_s16(vget_low_s16(cur)));
+				s1 = vaddq_s32(s1, vmovl_s16(vget_high_s16(cur)));
+
+				int16x4_t n0 = vqmovn_s32(s0);
+				int16x4_t n1 = vqmovn_s32(s1);
+				clip = vorrq_u32(clip, vmvnq_u32(vceqq_s32(s0, vmovl_s16(n0))));
+				clip = vorrq_u32(clip, vmvnq_u32(vceqq_s32(s1, vmovl_s16(n1))));
+
+				vst1q_s16(out+i, vcombine_s16(n0, n1));
+			}
+
+			if (vgetq_lane_u32(clip, 0) | vgetq_lane_u32(clip, 1) | vgetq_lane_u32(clip, 2) | vgetq_lane_u32(clip, 3)) clipping = true;
+		}
+#endif
+
+		for (; i<count; i++) {
+			int sample = (int)out[i] + (__oamlFloatToS24(samples[i], scale) >> 8);
+			if (sample < -32768) { sample = -32768; clipping = true; }
+			if (sample > 32767) { sample = 32767; clipping = true; }
+			out[i] = (int16_t)sample;
+		}
+
+		return clipping;
+	}
+};
+
+struct oamlMixOutput24 {
+	bool operator()(void *buffer, const float *samples, int count, float volume) const {
+		// Packed 3 bytes per sample, little endian
+		uint8_t *out = (uint8_t *)buffer;
+		float scale = volume * OAML_S24_SCALE;
+		bool clipping = false;
+
+		for (int i=0; i<count; i++, out+= 3) {
+			int cur = (int)out[0] | ((int)out[1] << 8) | ((int)out[2] << 16);
+			if (cur & 0x800000) cur|= ~0xffffff;
+
+			int sample = cur + __oamlFloatToS24(samples[i], scale);
+			if (sample < -8388608) { sample = -8388608; clipping = true; }
+			if (sample > 8388607) { sample = 8388607; clipping = true; }
+
+			out[0] = (uint8_t)sample;
+			out[1] = (uint8_t)(sample >> 8);
+			out[2] = (uint8_t)(sample >> 16);
+		}
+
+		return clipping;
+	}
+};
+
+struct oamlMixOutput32 {
+	bool operator()(void *buffer, const float *samples, int count, float volume) const {
+		int32_t *out = (int32_t *)buffer;
+		float scale = volume * OAML_S24_SCALE;
+		bool clipping = false;
+
+		for (int i=0; i<count; i++) {
+			int64_t sample = (int64_t)out[i] + (int64_t)__oamlFloatToS24(samples[i], scale) * 256;
+			if (sample < INT_MIN) { sample = INT_MIN; clipping = true; }
+			if (sample > INT_MAX) { sample = INT_MAX; clipping = true; }
+			out[i] = (int32_t)sample;
+		}
+
+		return clipping;
+	}
+};
+
+#endif /* __OAMLCONVERT_H__ */
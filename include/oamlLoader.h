@@ -0,0 +1,70 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLLOADER_H__
+#define __OAMLLOADER_H__
+
+//
+// Pool of worker threads that decode audio files in the background, so
+// tracks can be preloaded without spending any time on the game thread.
+// Threads are only started the first time something is queued.
+//
+
+class oamlLoader {
+private:
+	bool verbose;
+	bool quit;
+	int threadsCount;
+
+	std::vector<std::thread> threads;
+	std::deque<oamlAudioFile*> jobs;
+	std::set<oamlAudioFile*> pending;
+	int running;
+
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobDone;
+
+	void StartThreads();
+	void StopThreads();
+	void WorkerThread();
+	void Run(oamlAudioFile *file, std::unique_lock<std::mutex>& lock);
+
+public:
+	oamlLoader();
+	~oamlLoader();
+
+	void SetVerbose(bool option) { verbose = option; }
+	void SetThreads(int count);
+	int GetThreads() const { return threadsCount; }
+
+	void Queue(oamlAudioFile *file);
+	void Queue(std::vector<oamlAudioFile*>& files);
+
+	/** Loads all the files across the threads and the calling one, returns once they're all done */
+	oamlRC Load(std::vector<oamlAudioFile*>& files);
+
+	/** Drops any queued jobs and waits for the ones in progress, must be called before deleting any audio file */
+	void Flush();
+};
+
+#endif /* __OAMLLOADER_H__ */
@@ -0,0 +1,56 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLMAPPEDFILE_H__
+#define __OAMLMAPPEDFILE_H__
+
+//
+// A whole file mapped into memory through the map/unmap file callbacks. The
+// default callbacks use the OS memory mapping, so pages are loaded on demand
+// and shared through the page cache, and uncompressed audio can be played in
+// place without copying it into our own buffers. The mapping stays valid
+// after the file itself is closed.
+//
+
+class oamlMappedFile {
+private:
+	oamlFileCallbacks2 *fcbs;
+
+	const uint8_t *data;
+	size_t size;
+
+public:
+	oamlMappedFile();
+	~oamlMappedFile();
+
+	bool Open(oamlFileCallbacks2 *cbs, void *fd);
+	void Close();
+
+	const uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+
+	// map/unmap callbacks for files opened with fopen()
+	static const void* MapStdioFile(void *fd, size_t *size);
+	static void UnmapStdioFile(const void *ptr, size_t size);
+};
+
+#endif /* __OAMLMAPPEDFILE_H__ */
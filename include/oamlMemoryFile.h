@@ -0,0 +1,60 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLMEMORYFILE_H__
+#define __OAMLMEMORYFILE_H__
+
+//
+// The raw bytes of a compressed audio file kept in memory, so it can be
+// decoded while it plays without going back to the disk. The file is read
+// once through the file callbacks, or used in place when they can map it.
+//
+// Shared by an oamlSample and each stream decoding from it, streams may
+// still be reading after the sample is evicted so it's reference counted
+// and the last Release() deletes it.
+//
+
+class oamlMemoryFile {
+private:
+	std::atomic<int> refs;
+
+	oamlMappedFile *mapped;
+	std::vector<uint8_t> buffer;
+
+	const uint8_t *data;
+	size_t size;
+
+	~oamlMemoryFile();
+
+public:
+	oamlMemoryFile();
+
+	bool Load(const char *filename, oamlFileCallbacks2 *cbs);
+
+	void AddRef();
+	void Release();
+
+	const uint8_t* GetData() const { return data; }
+	size_t GetSize() const { return size; }
+};
+
+#endif /* __OAMLMEMORYFILE_H__ */
@@ -29,24 +29,37 @@ class oamlAudio;
 class oamlMusicTrack : public oamlTrack {
 private:
 	bool playing;
+	// Holds the reference PlayTrack prepared, until the track is stopped and done fading
+	bool prepared;
 	int playingOrder;
 	int maxPlayOrder;
-	int playCondSamples;
 
-	unsigned int filesSamples;
 	unsigned int tailPos;
 
 	std::vector<oamlAudio*> loopAudios;
 	std::vector<oamlAudio*> randAudios;
 	std::vector<oamlAudio*> condAudios;
 	std::vector<oamlAudio*> introAudios;
+
+	// Condition waiting for curAudio to reach a movement boundary, at playCondPos samples into it
+	bool playCondPending;
+	unsigned int playCondPos;
 	oamlAudio *playCondAudio;
 
+	// Loop audios driven by the main loop condition, and condition audios bucketed by their id
+	std::vector<oamlAudio*> mainLoopAudios;
+	std::unordered_map<int, std::vector<oamlAudio*> > condIndex;
+	// Last value applied for each condition id, repeating it is a no-op
+	std::unordered_map<int, int> condValues;
+	// Set by studio edits on the game thread, the index is rebuilt by the mixer before it's used again
+	std::atomic<bool> conditionsDirty;
+
 	oamlAudio *curAudio;
 	oamlAudio *tailAudio;
 	oamlAudio *fadeAudio;
 
 	oamlAudio* PickNextAudio();
+	void IndexConditions(std::vector<oamlAudio*> *audios);
 
 	void PlayNext();
 	void PlayCond(oamlAudio *audio);
@@ -58,19 +71,23 @@ public:
 	~oamlMusicTrack();
 
 	void GetAudioList(std::vector<std::string>& list);
+	void GetAudioFiles(std::vector<oamlAudioFile*>& list);
 	void AddAudio(oamlAudio *audio);
-	oamlAudio* GetAudio(std::string filename);
-	oamlRC RemoveAudio(std::string filename);
+	oamlRC RemoveAudio(const std::string& audioName);
+	void ReindexAudios();
+	void ReindexConditions();
+	void InvalidateConditions() { conditionsDirty = true; }
+	int GetAudiosCount() const;
+	oamlRC Prepare();
+	void Unprepare();
 	oamlRC Play();
-	oamlRC Load();
-	float LoadProgress();
 	void Stop();
 
 	bool IsPlaying();
 	void ShowPlaying();
 	std::string GetPlayingInfo();
 
-	void Mix(float *samples, int channels, bool debugClipping);
+	void Mix(float *samples, int frames, int channels, bool debugClipping);
 
 	void SetCondition(int id, int value);
 
@@ -78,7 +95,7 @@ public:
 
 	void ReadInfo(oamlTrackInfo *info);
 
-	void FreeMemory();
+	void Release();
 };
 
 #endif
@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLPCMBUFFER_H__
+#define __OAMLPCMBUFFER_H__
+
+//
+// Decoded audio samples stored in a contiguous array, filled once at load
+// time so the mixer can read them without any per-sample format handling.
+// 8 and 16 bit sources are kept as int16, anything wider as float. 32 bit
+// data comes in as float already and is copied as is, float decoders write
+// straight into the array through GetAppendFloats().
+//
+// The arrays are allocated with Reserve() before decoding starts and the
+// number of valid samples is published atomically, so the mixer can read
+// while a loader thread is still appending.
+//
+// Uncompressed files that could be memory mapped aren't decoded at all, the
+// buffer points into the mapping and converts each sample as it's mixed.
+//
+
+class oamlPcmBuffer {
+private:
+	bool useFloat;
+	bool reserved;
+	std::atomic<unsigned int> count;
+
+	std::vector<int16_t> pcm16;
+	std::vector<float> pcmFloat;
+
+	oamlMappedFile *mapped;
+	const uint8_t *mappedData;
+	int mappedFormat;
+
+	unsigned int MakeRoom(unsigned int pos, unsigned int samples);
+	void MixMapped(float *samples, unsigned int pos, unsigned int samplesCount, float gain) const;
+
+public:
+	oamlPcmBuffer();
+	~oamlPcmBuffer();
+
+	void SetFormat(int bytesPerSample);
+	void Reserve(unsigned int samples);
+	bool IsFloat() const { return useFloat; }
+	unsigned int Size() const { return count.load(std::memory_order_acquire); }
+
+	void Decode(const uint8_t *data, unsigned int samples, int bytesPerSample);
+	/** For decoders that produce floats: where the next samples go, samples is trimmed to the room left */
+	float* GetAppendFloats(unsigned int& samples);
+	/** Publishes samples written through GetAppendFloats() to readers */
+	void CommitAppend(unsigned int samples);
+	void Map(oamlMappedFile *file, const uint8_t *data, unsigned int samples, int format);
+	bool IsMapped() const { return mapped != NULL; }
+	void Mix(float *samples, unsigned int pos, unsigned int samplesCount, float gain) const;
+
+	static void ToFloat(const uint8_t *data, float *samples, unsigned int samplesCount, int bytesPerSample);
+
+	size_t GetMemorySize() const;
+	void Free();
+};
+
+#endif /* __OAMLPCMBUFFER_H__ */
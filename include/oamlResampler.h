@@ -0,0 +1,83 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLRESAMPLER_H__
+#define __OAMLRESAMPLER_H__
+
+#define OAML_RESAMPLER_TAPS		64
+#define OAML_RESAMPLER_MAX_PHASES	1024
+
+//
+// Converts audio from a file's sample rate to the output rate with a
+// polyphase windowed sinc filter. The ratio is reduced to up/down and
+// output frame n is taken from input position n * down / up, worked out
+// from n alone, so decoding a whole file or a stream that seeks anywhere
+// gives exactly the same samples.
+//
+// Input is kept per channel so each output sample is a dot product of two
+// contiguous arrays, written so compilers turn it into vector code.
+//
+
+class oamlResampler {
+private:
+	unsigned int channels;
+	uint64_t up;
+	uint64_t down;
+
+	unsigned int phases;
+	unsigned int taps;
+	std::vector<float> coeffs;
+
+	// Input frames not needed anymore are dropped from the front now and then
+	std::vector< std::vector<float> > history;
+	int64_t historyStart;
+
+	uint64_t outPos;
+	uint64_t outEnd;
+	bool ended;
+
+	// A frame split between two Read() calls
+	std::vector<float> pending;
+	unsigned int pendingPos;
+
+	void BuildFilter();
+	int64_t GetFirstInput(uint64_t frame) const;
+	bool ComputeFrame(float *frame);
+	void Trim();
+
+public:
+	oamlResampler(unsigned int _channels, unsigned int inRate, unsigned int outRate);
+	~oamlResampler();
+
+	static uint64_t GetOutputFrames(uint64_t inputFrames, unsigned int inRate, unsigned int outRate);
+
+	/** Starts producing output at frame, returns the input frame Write() has to continue from */
+	uint64_t Reset(uint64_t frame);
+	/** Appends interleaved input frames */
+	void Write(const float *samples, unsigned int frames);
+	/** No more input, whatever is left is flushed out against silence */
+	void End();
+	/** Interleaved output samples, count doesn't have to be whole frames. Returns less when it needs more input */
+	unsigned int Read(float *samples, unsigned int count);
+};
+
+#endif /* __OAMLRESAMPLER_H__ */
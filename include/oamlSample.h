@@ -0,0 +1,162 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLSAMPLE_H__
+#define __OAMLSAMPLE_H__
+
+class oamlSampleCache;
+
+// Header values of an audio file, enough to plan decoding or streaming it without opening it
+typedef struct {
+	unsigned int channels;
+	unsigned int samplesPerSec;
+	unsigned int totalSamples;
+	unsigned int bytesPerSample;
+	int pcmFormat;
+	// Size of the file the header was read from, to tell if it changed since
+	unsigned int fileSize;
+} oamlFileInfo;
+
+//
+// Decoded contents of one audio file on disk. Samples are owned by
+// oamlSampleCache and shared by every oamlAudioFile that points at the same
+// filename, so a file used by several audios or tracks is only decoded and
+// stored once. Once decoded the pcm data is never modified.
+//
+// Streamed samples only keep their first seconds decoded, the rest is read
+// from disk by each user's oamlStream while playing. With compressed
+// playback enabled compressed files are streamed too, but from a copy of the
+// whole file kept in memory.
+//
+// Files at another rate than the output are resampled while decoding, sample
+// counts and rates are then those at the output rate. info always keeps the
+// file's own values.
+//
+
+class oamlSample {
+private:
+	bool verbose;
+	oamlFileCallbacks2 *fcbs;
+	oamlSampleCache *cache;
+	std::string filename;
+
+	oamlPcmBuffer pcm;
+	ByteBuffer readBuffer;
+	audioFile *handle;
+	oamlMemoryFile *compressed;
+
+	unsigned int bytesPerSample;
+	unsigned int samplesPerSec;
+	unsigned int totalSamples;
+	unsigned int channelCount;
+
+	// Set while the file is converted to the output rate, 0 otherwise
+	unsigned int outputRate;
+	oamlResampler *resampler;
+	std::vector<float> resampleBuffer;
+
+	// Header values from oamlSampleCache or the last time the file was opened, kept when evicted
+	bool hasInfo;
+	oamlFileInfo info;
+
+	// How much of the file is kept decoded in pcm, all of it unless it's streamed
+	unsigned int residentSamples;
+	bool streamRequested;
+	std::atomic<bool> streaming;
+
+	bool loadFailed;
+
+	// Guards handle and decoding, held by the loader threads one chunk at a time
+	std::mutex decodeMutex;
+
+	// Owners are counted by oamlSampleCache, users are the audio files currently playing it
+	int refs;
+	std::atomic<int> users;
+	std::atomic<int> pins;
+
+	// Set by oamlSampleCache for the LRU eviction
+	std::atomic<uint64_t> lastUsed;
+	std::atomic<size_t> memorySize;
+
+	oamlRC OpenFile();
+	void SetupBuffers();
+	void LoadCompressed();
+	void FreeCompressed();
+	void ResetInfo();
+	void ApplyOutputRate();
+	bool IsRateStale();
+	bool CanOpenFromInfo();
+	bool WillStream();
+
+	int Read();
+	int ReadFloat();
+	int ReadResampled();
+	void CloseHandle();
+	void FreeData();
+	void SetMemorySize(size_t size);
+	bool Decode(unsigned int samples);
+
+	friend class oamlSampleCache;
+
+public:
+	oamlSample(std::string _filename, oamlFileCallbacks2 *cbs, oamlSampleCache *_cache, bool _verbose);
+	~oamlSample();
+
+	static audioFile* OpenHandle(const char *filename, oamlFileCallbacks2 *cbs, oamlMemoryFile *source = NULL);
+	static bool IsCompressedFile(const char *filename);
+	static bool ProbeInfo(const char *filename, oamlFileCallbacks2 *cbs, oamlFileInfo *info);
+	static unsigned int GetFileSize(const char *filename, oamlFileCallbacks2 *cbs);
+
+	std::string GetFilename() const { return filename; }
+	const char *GetFilenameStr() const { return filename.c_str(); }
+
+	oamlRC Open();
+	oamlRC Load();
+	float LoadProgress();
+	bool IsLoaded();
+	void Mix(float *samples, unsigned int pos, unsigned int count, float gain);
+
+	unsigned int GetChannels() const { return channelCount; }
+	unsigned int GetTotalSamples() const { return totalSamples; }
+	unsigned int GetSamplesPerSec() const { return samplesPerSec; }
+	void SetInfo(const oamlFileInfo& fileInfo);
+
+	void SetStreaming();
+	bool IsStreamRequested() const { return streamRequested; }
+	bool IsStreaming() const { return streaming.load(); }
+	unsigned int GetResidentSamples() const { return pcm.Size(); }
+	oamlStream* CreateStream();
+
+	void AddUser();
+	void RemoveUser();
+	int GetUsers() const { return users.load(); }
+
+	void Pin() { pins++; }
+	void Unpin() { pins--; }
+	bool IsPinned() const { return pins.load() > 0; }
+
+	size_t GetMemorySize() const { return memorySize.load(); }
+	uint64_t GetLastUsed() const { return lastUsed.load(); }
+	bool Evict();
+};
+
+#endif /* __OAMLSAMPLE_H__ */
@@ -0,0 +1,89 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLSAMPLECACHE_H__
+#define __OAMLSAMPLECACHE_H__
+
+#define OAML_CACHE_BUDGET_DEFAULT	(128*1024*1024)
+
+//
+// Keeps one oamlSample per filename, reference counted by the audio files
+// that use it. Decoded data stays in memory after a track stops and is only
+// evicted, least recently used first, once the total goes over the budget.
+// Files over the streaming threshold are played through oamlStreamer instead,
+// as are compressed files kept in memory when compressed playback is on.
+//
+// The header of every file seen is remembered too, by filename, so files
+// can be planned for without opening them again, even after their sample
+// is gone. It can be filled ahead of time from compiled defs.
+//
+
+class oamlSampleCache {
+private:
+	std::map<std::string, oamlSample*> samples;
+	std::mutex mutex;
+
+	size_t budget;
+	std::atomic<uint64_t> clock;
+	// Sum of every sample's memory size, kept up to date by the samples themselves
+	std::atomic<size_t> memoryUsage;
+
+	std::atomic<size_t> streamingThreshold;
+	std::atomic<bool> compressedPlayback;
+	std::atomic<unsigned int> outputRate;
+	oamlStreamer streamer;
+
+	// Separate from mutex as samples store their info while holding their decode lock
+	std::map<std::string, oamlFileInfo> infos;
+	std::mutex infoMutex;
+
+public:
+	oamlSampleCache();
+	~oamlSampleCache();
+
+	oamlSample* Acquire(std::string filename, oamlFileCallbacks2 *cbs, bool verbose);
+	void Release(oamlSample *sample);
+
+	int GetCount();
+
+	void SetBudget(size_t bytes) { budget = bytes; }
+	size_t GetBudget() const { return budget; }
+	size_t GetMemoryUsage();
+	void UpdateMemoryUsage(size_t oldSize, size_t newSize) { memoryUsage+= newSize; memoryUsage-= oldSize; }
+
+	void Touch(oamlSample *sample);
+	void Trim();
+
+	void SetStreamingThreshold(size_t bytes) { streamingThreshold = bytes; }
+	size_t GetStreamingThreshold() const { return streamingThreshold.load(); }
+	void SetCompressedPlayback(bool enable) { compressedPlayback = enable; }
+	bool GetCompressedPlayback() const { return compressedPlayback.load(); }
+	void SetOutputRate(unsigned int rate);
+	unsigned int GetOutputRate() const { return outputRate.load(); }
+	oamlStreamer* GetStreamer() { return &streamer; }
+
+	void StoreInfo(const std::string& filename, const oamlFileInfo& info);
+	bool GetInfo(const std::string& filename, oamlFileInfo *info);
+	void SetInfo(const std::string& filename, const oamlFileInfo& info);
+};
+
+#endif /* __OAMLSAMPLECACHE_H__ */
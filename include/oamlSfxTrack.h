@@ -23,6 +23,8 @@
 #ifndef __OAMLSFXTRACK_H__
 #define __OAMLSFXTRACK_H__
 
+#define OAML_SFX_MAX_PLAYING	32
+
 class ByteBuffer;
 class oamlAudio;
 
@@ -36,28 +38,35 @@ typedef struct {
 class oamlSfxTrack : public oamlTrack {
 private:
 	std::vector<oamlAudio*> sfxAudios;
-	std::vector<sfxPlayInfo> playingAudios;
+	// Fixed size so playing never allocates on the audio thread, plays past it are dropped
+	sfxPlayInfo playingAudios[OAML_SFX_MAX_PLAYING];
+	int playingCount;
+
+	bool IsAudioPlaying(oamlAudio *audio);
 
 public:
 	oamlSfxTrack(bool _verbose);
 	~oamlSfxTrack();
 
 	void GetAudioList(std::vector<std::string>& list);
+	void GetAudioFiles(std::vector<oamlAudioFile*>& list);
 	void AddAudio(oamlAudio *audio);
-	oamlAudio* GetAudio(std::string filename);
+	void ReindexAudios();
+	int GetAudiosCount() const;
 	oamlRC Play(const char *name, float vol, float pan);
+	oamlRC PlayAudio(oamlAudio *audio, float vol, float pan);
 	void Stop();
 
 	bool IsPlaying();
 	std::string GetPlayingInfo();
 
-	void Mix(float *samples, int channels, bool debugClipping);
+	void Mix(float *samples, int frames, int channels, bool debugClipping);
 
 	bool IsSfxTrack() const { return true; }
 
 	void ReadInfo(oamlTrackInfo *info);
 
-	void FreeMemory();
+	void Release();
 };
 
 #endif
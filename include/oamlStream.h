@@ -0,0 +1,97 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLSTREAM_H__
+#define __OAMLSTREAM_H__
+
+#define OAML_STREAM_BUFFER_MS	500
+#define OAML_STREAM_HEAD_MS	2000
+
+//
+// Plays a long file from disk through a fixed size ring buffer, instead of
+// decoding all of it into memory. The mixer reads from the ring and
+// oamlStreamer refills it from its own thread, so neither side ever waits on
+// the other. Each stream has its own file handle and read position, the
+// handle decodes from the sample's in memory copy of the file if it has one.
+//
+// Positions are in samples from the start of the file. The ring holds the
+// samples between readPos and writePos, readPos only moves on the mixer side
+// and writePos only on the streamer side. Jumping anywhere else is a seek
+// request the streamer handles on its next pass, until then the stream plays
+// silence. Files at another rate than the output are resampled as they're
+// read, positions are always at the output rate.
+//
+
+class oamlStream {
+private:
+	std::string filename;
+	oamlFileCallbacks2 *fcbs;
+	oamlMemoryFile *source;
+
+	unsigned int bytesPerSample;
+	unsigned int totalSamples;
+	unsigned int channelCount;
+
+	std::vector<float> ring;
+	std::atomic<unsigned int> readPos;
+	std::atomic<unsigned int> writePos;
+
+	std::atomic<unsigned int> seekPos;
+	std::atomic<unsigned int> seekRequest;
+	std::atomic<unsigned int> seekDone;
+	std::atomic<bool> closed;
+
+	// Streamer side
+	audioFile *handle;
+	ByteBuffer readBuffer;
+	std::vector<float> decodeBuffer;
+	oamlResampler *resampler;
+	std::vector<float> inputBuffer;
+	unsigned int filePos;
+	bool inputEnded;
+	bool failed;
+
+	// Mixer side
+	unsigned int nextPos;
+
+	bool OpenHandle();
+	void CloseHandle();
+	bool SeekHandle(unsigned int pos);
+	unsigned int ReadFile(float *samples, unsigned int count);
+	unsigned int ReadHandle(float *samples, unsigned int count);
+
+public:
+	oamlStream(std::string _filename, oamlFileCallbacks2 *cbs, oamlMemoryFile *_source, unsigned int _bytesPerSample, unsigned int _totalSamples, unsigned int bufferSamples, unsigned int channels, unsigned int fileRate, unsigned int outputRate);
+	~oamlStream();
+
+	// Mixer side
+	void Read(float *samples, unsigned int pos, unsigned int count, float gain, unsigned int resident);
+	unsigned int GetNextPos() const { return nextPos; }
+	void Close() { closed.store(true, std::memory_order_release); }
+
+	// Streamer side
+	bool IsClosed() const { return closed.load(std::memory_order_acquire); }
+	bool Fill();
+	size_t GetMemorySize() const;
+};
+
+#endif /* __OAMLSTREAM_H__ */
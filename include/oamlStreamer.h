@@ -0,0 +1,53 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __OAMLSTREAMER_H__
+#define __OAMLSTREAMER_H__
+
+//
+// Background thread that keeps the ring buffers of every open oamlStream
+// filled. Streams are closed from the mixer side and deleted here, so the
+// mixer never has to wait for the thread to let go of one.
+//
+
+class oamlStreamer {
+private:
+	bool quit;
+
+	std::vector<oamlStream*> streams;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wake;
+
+	void StreamerThread();
+
+public:
+	oamlStreamer();
+	~oamlStreamer();
+
+	void Add(oamlStream *stream);
+	void Wake() { wake.notify_one(); }
+
+	size_t GetMemoryUsage();
+};
+
+#endif /* __OAMLSTREAMER_H__ */
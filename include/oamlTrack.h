@@ -25,6 +25,7 @@
 
 class ByteBuffer;
 class oamlAudio;
+class oamlAudioFile;
 
 class oamlTrack {
 protected:
@@ -34,29 +35,40 @@ protected:
 	std::vector<std::string> groups;
 	std::vector<std::string> subgroups;
 
-	int lock;
 	int fadeIn;
 	int fadeOut;
 	int xfadeIn;
 	int xfadeOut;
 	float volume;
 
-	int Random(int min, int max);
+	std::vector<float> audioBuffer;
+
+	// Audios by name for GetAudio(), the first one added wins if a name repeats
+	std::unordered_map<std::string, oamlAudio*> audioIndex;
 
-	void ApplyVolPanTo(float *samlpes, int channels, float vol, float pan);
-	float SafeAdd(float a, float b, bool debug);
-	void MixAudio(oamlAudio *audio, float *samples, int channels, bool debug);
-	unsigned int MixAudio(oamlAudio *audio, float *samples, int channels, bool debug, unsigned int pos);
+	int Random(int min, int max);
 
-	oamlAudio* FindAudio(std::vector<oamlAudio*> *audios, std::string filename);
-	oamlRC FindAudioAndRemove(std::vector<oamlAudio*> *audios, std::string filename);
+	void ApplyVolPanTo(float *samples, int frames, int channels, float vol, float pan);
+	template <bool CHECK_CLIPPING>
+	float SafeAdd(float a, float b);
+	template <bool CHECK_CLIPPING>
+	void AddSamples(float *samples, const float *buf, int size, float vol);
+	void AddSamples(float *samples, const float *buf, int size, float vol, bool debug);
+	float *GetAudioBuffer(int size);
+	void MixAudio(oamlAudio *audio, float *samples, int frames, int channels, bool debug);
+	unsigned int MixAudio(oamlAudio *audio, float *samples, int frames, int channels, bool debug, unsigned int pos);
+
+	void IndexAudio(oamlAudio *audio);
+	void IndexAudios(std::vector<oamlAudio*> *audios);
+	oamlRC FindAudioAndRemove(std::vector<oamlAudio*> *audios, const std::string& audioName);
 	void ClearAudios(std::vector<oamlAudio*> *audios);
 	void ReadAudiosInfo(std::vector<oamlAudio*> *audios, oamlTrackInfo *info);
-	void FreeAudiosMemory(std::vector<oamlAudio*> *audios);
+	void ReleaseAudios(std::vector<oamlAudio*> *audios);
+	oamlRC PrepareAudios(std::vector<oamlAudio*> *audios);
+	void UnprepareAudios(std::vector<oamlAudio*> *audios);
 	void FillAudiosList(std::vector<oamlAudio*> *audios, std::vector<std::string>& list);
 
-	int GetFilesSamplesFor(std::vector<oamlAudio*> *audios);
-	int LoadProgressFor(std::vector<oamlAudio*> *audios);
+	void FillAudioFilesList(std::vector<oamlAudio*> *audios, std::vector<oamlAudioFile*>& list);
 
 public:
 	oamlTrack();
@@ -77,8 +89,9 @@ public:
 	std::string GetName() const { return name; }
 	std::vector<std::string> GetGroups() const { return groups; }
 	std::vector<std::string> GetSubgroups() const { return subgroups; }
-	bool HasGroup(std::string trackGroup) const { return std::find(groups.begin(), groups.end(), trackGroup) != groups.end(); }
-	bool HasSubgroup(std::string trackSubgroup) const { return std::find(subgroups.begin(), subgroups.end(), trackSubgroup) != subgroups.end(); }
+	// Tracks only have a handful of groups, a scan is quicker than hashing
+	bool HasGroup(const char *trackGroup) const;
+	bool HasSubgroup(const char *trackSubgroup) const;
 	int GetFadeIn() const { return fadeIn; }
 	int GetFadeOut() const { return fadeOut; }
 	int GetXFadeIn() const { return xfadeIn; }
@@ -86,28 +99,39 @@ public:
 	float GetVolume() const { return volume; }
 
 	virtual void GetAudioList(std::vector<std::string>&) { }
+	virtual void GetAudioFiles(std::vector<oamlAudioFile*>&) { }
 	virtual void AddAudio(oamlAudio *) { }
-	virtual oamlAudio* GetAudio(std::string) { return NULL; }
-	virtual oamlRC RemoveAudio(std::string) { return OAML_NOT_FOUND; }
+	oamlAudio* GetAudio(const std::string& audioName) const;
+	virtual oamlRC RemoveAudio(const std::string&) { return OAML_NOT_FOUND; }
+	/** Rebuilds the audio index, after an audio was renamed */
+	virtual void ReindexAudios() { }
+	/** Rebuilds the condition index, only while the mixer isn't using the track */
+	virtual void ReindexConditions() { }
+	/** Marks the condition index stale, the mixer rebuilds it before dispatching the next condition */
+	virtual void InvalidateConditions() { }
+	virtual int GetAudiosCount() const { return 0; }
 	virtual oamlRC Play() { return OAML_NOT_FOUND; }
 	virtual oamlRC Play(const char *) { return OAML_NOT_FOUND; }
 	virtual oamlRC Play(const char *, float, float) { return OAML_NOT_FOUND; }
-	virtual oamlRC Load() { return OAML_NOT_FOUND; }
-	virtual float LoadProgress() { return -1.f; }
+	virtual oamlRC PlayAudio(oamlAudio *, float, float) { return OAML_NOT_FOUND; }
+	float LoadProgress();
+	/** Opens every audio the track may play, on the calling thread, so playing it never waits on a file */
+	virtual oamlRC Prepare() { return OAML_OK; }
+	virtual void Unprepare() { }
 	virtual void Stop() { }
 
 	virtual bool IsPlaying() { return false; }
 	void ShowPlaying();
 	virtual std::string GetPlayingInfo() { return ""; }
 
-	virtual void Mix(float *, int, bool) { }
+	virtual void Mix(float *, int, int, bool) { }
 
 	virtual void SetCondition(int, int) { }
 
 	virtual bool IsMusicTrack() const { return false; }
 	virtual bool IsSfxTrack() const { return false; }
 
-	virtual void FreeMemory() { }
+	virtual void Release() { }
 };
 
 #endif
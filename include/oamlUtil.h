@@ -25,6 +25,7 @@
 
 
 float __oamlInteger24ToFloat(int i);
+float __oamlInteger32ToFloat(int i);
 int __oamlFloatToInteger24(float f);
 int __oamlRandom(int min, int max);
 void __oamlLog(const char* fmt, ...);
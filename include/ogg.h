@@ -34,8 +34,16 @@ private:
 	int totalSamples;
 
 	int currentSection;
+
+	// Samples of a frame that didn't fit in the last ReadFloat call
+	std::vector<float> pending;
+	size_t pendingPos;
+
+	// Set when decoding from memory, either our own mapping or a source file
+	const uint8_t *memData;
+	size_t memPos;
 public:
-	oggFile(oamlFileCallbacks *cbs);
+	oggFile(oamlFileCallbacks2 *cbs);
 	~oggFile();
 
 	int GetFormat() const { return format; }
@@ -49,8 +57,17 @@ public:
 
 	int Open(const char *filename);
 	int Read(ByteBuffer *buffer, int size);
+	int Seek(unsigned int frame);
+
+	bool IsFloat() const { return true; }
+	int ReadFloat(float *samples, int count);
 
 	void Close();
+
+	// Data source for vorbisfile, reads from the mapping when there is one
+	size_t ReadSource(void *ptr, size_t size, size_t nmemb);
+	int SeekSource(long offset, int whence);
+	long TellSource();
 };
 
 #endif /* __OGG_H__ */
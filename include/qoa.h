@@ -0,0 +1,79 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#ifndef __QOA_H__
+#define __QOA_H__
+
+//
+// Quite OK Audio (https://qoaformat.org), a lossy format of fixed size
+// frames with a tiny LMS predictor per channel. It compresses about 5:1
+// and decodes many times faster than vorbis, so it suits lots of streamed
+// stems. Decodes to 16 bit samples, frames have a fixed size so seeking
+// is just an offset.
+//
+
+#define QOA_SLICE_LEN		20
+#define QOA_SLICES_PER_FRAME	256
+#define QOA_FRAME_LEN		(QOA_SLICES_PER_FRAME * QOA_SLICE_LEN)
+#define QOA_MAX_CHANNELS	8
+
+class qoaFile : public audioFile {
+private:
+	int channels;
+	int samplesPerSec;
+	int totalSamples;
+
+	// Set when decoding from memory, either our own mapping or a source file
+	const uint8_t *memData;
+	size_t memPos;
+
+	// Last decoded frame and how much of it was handed out
+	std::vector<uint8_t> frameData;
+	std::vector<int16_t> frameSamples;
+	unsigned int frameSize;
+	unsigned int framePos;
+
+	size_t ReadData(void *ptr, size_t bytes);
+	bool SeekData(size_t offset);
+	int DecodeFrame();
+
+public:
+	qoaFile(oamlFileCallbacks2 *cbs);
+	~qoaFile();
+
+	int GetFormat() const { return 0; }
+	int GetChannels() const { return channels; }
+	int GetSamplesPerSec() const { return samplesPerSec; }
+	int GetBitsPerSample() const { return 16; }
+	int GetBytesPerSample() const { return 2; }
+	int GetTotalSamples() const { return totalSamples; }
+
+	int Open(const char *filename);
+	int Read(ByteBuffer *buffer, int size);
+	int Seek(unsigned int frame);
+
+	void WriteToFile(const char *filename, ByteBuffer *buffer, int channels, unsigned int sampleRate, int bytesPerSample);
+
+	void Close();
+};
+
+#endif /* __QOA_H__ */
@@ -35,8 +35,9 @@ private:
 	int status;
 
 	int ReadChunk();
+	void ConvertData(unsigned char *buf, int size);
 public:
-	wavFile(oamlFileCallbacks *cbs);
+	wavFile(oamlFileCallbacks2 *cbs);
 	~wavFile();
 
 	int GetFormat() const { return format; }
@@ -45,9 +46,11 @@ public:
 	int GetBitsPerSample() const { return bitsPerSample; }
 	int GetBytesPerSample() const { return bitsPerSample / 8; }
 	int GetTotalSamples() const { return totalSamples; }
+	int GetPcmFormat() const;
 
 	int Open(const char *filename);
 	int Read(ByteBuffer *buffer, int size);
+	int Seek(unsigned int frame);
 
 	void WriteToFile(const char *filename, ByteBuffer *buffer, int channels, unsigned int sampleRate, int bytesPerSample);
 
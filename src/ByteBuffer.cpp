@@ -139,6 +139,37 @@ void ByteBuffer::resize(uint32_t newSize) {
 	wpos = 0;
 }
 
+/**
+ * Reserve
+ * Preallocates memory for the internal buffer so that appending up to newCapacity bytes doesn't reallocate
+ *
+ * @param newCapacity The amount of memory to preallocate
+ */
+void ByteBuffer::reserve(uint32_t newCapacity) {
+	buf.reserve(newCapacity);
+}
+
+/**
+ * Grow
+ * Resizes the internal buffer to at least newSize bytes. Capacity is doubled when it runs out so
+ * that many small appends don't end up reallocating every time
+ *
+ * @param newSize The minimum size needed
+ */
+void ByteBuffer::grow(uint32_t newSize) {
+	if (buf.size() >= newSize)
+		return;
+
+	if (buf.capacity() < newSize) {
+		size_t newCapacity = buf.capacity() * 2;
+		if (newCapacity < newSize)
+			newCapacity = newSize;
+		buf.reserve(newCapacity);
+	}
+
+	buf.resize(newSize);
+}
+
 /**
  * Size
  * Returns the size of the internal buffer...not necessarily the length of bytes used as data!
@@ -164,9 +195,17 @@ uint8_t ByteBuffer::get(uint32_t index) {
 }
 
 void ByteBuffer::getBytes(uint8_t* buf, uint32_t len) {
-	for(uint32_t i = 0; i < len; i++) {
-		buf[i] = read<uint8_t>();
+	uint32_t avail = rpos < size() ? bytesRemaining() : 0;
+	uint32_t bytes = len < avail ? len : avail;
+
+	if (bytes > 0) {
+		memcpy(buf, &this->buf[rpos], bytes);
+		rpos += bytes;
 	}
+
+	// Reading past the end returns zeroes, same as read<T>() does
+	if (bytes < len)
+		memset(buf + bytes, 0, len - bytes);
 }
 
 char ByteBuffer::getChar() {
@@ -222,8 +261,8 @@ uint16_t ByteBuffer::getShort(uint32_t index) {
 
 void ByteBuffer::put(ByteBuffer* src) {
 	uint32_t len = src->size();
-	for(uint32_t i = 0; i < len; i++)
-		append<uint8_t>(src->get(i));
+	if (len > 0)
+		putBytes(&src->buf[0], len);
 }
 
 void ByteBuffer::put(uint8_t b) {
@@ -235,17 +274,19 @@ void ByteBuffer::put(uint8_t b, uint32_t index) {
 }
 
 void ByteBuffer::putBytes(uint8_t* b, uint32_t len) {
-	// Insert the data one byte at a time into the internal buffer at position i+starting index
-	for(uint32_t i = 0; i < len; i++)
-		append<uint8_t>(b[i]);
+	if (len == 0)
+		return;
+
+	// Copy the whole block into the internal buffer at the write position
+	grow(wpos + len);
+	memcpy(&buf[wpos], b, len);
+	wpos += len;
 }
 
 void ByteBuffer::putBytes(uint8_t* b, uint32_t len, uint32_t index) {
 	wpos = index;
 
-	// Insert the data one byte at a time into the internal buffer at position i+starting index
-	for(uint32_t i = 0; i < len; i++)
-		append<uint8_t>(b[i]);
+	putBytes(b, len);
 }
 
 void ByteBuffer::putChar(char value) {
@@ -73,7 +73,7 @@ typedef struct {
 #endif
 
 
-aifFile::aifFile(oamlFileCallbacks *cbs) : audioFile(cbs) {
+aifFile::aifFile(oamlFileCallbacks2 *cbs) : audioFile(cbs) {
 	fd = NULL;
 
 	channels = 0;
@@ -109,9 +109,26 @@ int aifFile::Open(const char *filename) {
 		}
 	}
 
+	// Read the data straight from memory when we can
+	if (GetPcmFormat() != OAML_PCM_NONE && MapFile()) {
+		chunkSize = dataSize;
+		totalSamples = chunkSize / (bitsPerSample/8);
+	}
+
 	return 0;
 }
 
+int aifFile::GetPcmFormat() const {
+	switch (bitsPerSample) {
+		case 8: return OAML_PCM_S8;
+		case 16: return OAML_PCM_S16BE;
+		case 24: return OAML_PCM_S24BE;
+		case 32: return OAML_PCM_S32BE;
+	}
+
+	return OAML_PCM_NONE;
+}
+
 /*
  * C O N V E R T   F R O M   I E E E   E X T E N D E D  
  */
@@ -234,6 +251,8 @@ int aifFile::ReadChunk() {
 				fcbs->seek(fd, SWAP32(ssnd.offset), SEEK_CUR);
 			}
 
+			dataOffset = (unsigned int)fcbs->tell(fd);
+			dataSize = SWAP32(header.size) - 8;
 			chunkSize = SWAP32(header.size) - 8;
 			totalSamples = chunkSize / (bitsPerSample/8);
 			status = 2;
@@ -247,6 +266,38 @@ int aifFile::ReadChunk() {
 	return 0;
 }
 
+void aifFile::ConvertData(unsigned char *buf, int size) {
+	// Aiff data is signed and big endian, we hand it out as unsigned 8bit and little endian
+	if (bitsPerSample == 8) {
+		char *cbuf = (char*)buf;
+		for (int i=0; i<size; i++) {
+			cbuf[i] = cbuf[i]+128;
+		}
+	} else
+	if (bitsPerSample == 16) {
+		unsigned short *sbuf = (unsigned short *)buf;
+		for (int i=0; i<size; i+= 2) {
+			sbuf[i>>1] = SWAP16(sbuf[i>>1]);
+		}
+	} else
+	if (bitsPerSample == 24) {
+		for (int i=0; i<size; i+= 3) {
+			unsigned char tmp;
+			tmp = buf[i+0];
+			buf[i+0] = buf[i+2];
+			buf[i+2] = tmp;
+		}
+	} else
+	if (bitsPerSample == 32) {
+		// 32 bit is handed out as float
+		for (int i=0; i+4<=size; i+= 4) {
+			int32_t value = (int32_t)(((uint32_t)buf[i] << 24) | (buf[i+1] << 16) | (buf[i+2] << 8) | buf[i+3]);
+			float f = __oamlInteger32ToFloat(value);
+			memcpy(buf + i, &f, 4);
+		}
+	}
+}
+
 int aifFile::Read(ByteBuffer *buffer, int size) {
 	int bufSize = 4096*GetBytesPerSample();
 	unsigned char buf[4096*4];
@@ -262,33 +313,22 @@ int aifFile::Read(ByteBuffer *buffer, int size) {
 			int bytes = size < bufSize ? size : bufSize;
 			if (chunkSize < bytes)
 				bytes = chunkSize;
-			int ret = fcbs->read(buf, 1, bytes, fd);
+
+			int ret;
+			if (mapped) {
+				ret = bytes > 0 ? bytes : 0;
+				memcpy(buf, mapped->GetData() + dataOffset + (dataSize - chunkSize), ret);
+			} else {
+				ret = (int)ReadBytes(buf, bytes);
+			}
+
 			if (ret == 0) {
 				status = 3;
 				break;
 			} else {
 				chunkSize-= ret;
 
-				if (bitsPerSample == 8) {
-					char *cbuf = (char*)buf;
-					for (int i=0; i<ret; i++) {
-						cbuf[i] = cbuf[i]+128;
-					}
-				} else
-				if (bitsPerSample == 16) {
-					unsigned short *sbuf = (unsigned short *)buf;
-					for (int i=0; i<ret; i+= 2) {
-						sbuf[i>>1] = SWAP16(sbuf[i>>1]);
-					}
-				} else
-				if (bitsPerSample == 24) {
-					for (int i=0; i<ret; i+= 3) {
-						unsigned char tmp;
-						tmp = buf[i+0];
-						buf[i+0] = buf[i+2];
-						buf[i+2] = tmp;
-					}
-				}
+				ConvertData(buf, ret);
 
 				buffer->putBytes(buf, ret);
 				bytesRead+= ret;
@@ -303,6 +343,24 @@ int aifFile::Read(ByteBuffer *buffer, int size) {
 	return bytesRead;
 }
 
+int aifFile::Seek(unsigned int frame) {
+	if (fd == NULL || status < 2)
+		return -1;
+
+	// Frames are stored back to back in the SSND chunk, right after its header and offset
+	unsigned int offset = frame * channels * (bitsPerSample/8);
+	if (offset > dataSize) {
+		offset = dataSize;
+	}
+
+	if (mapped == NULL && fcbs->seek(fd, dataOffset + offset, SEEK_SET) != 0)
+		return -1;
+
+	chunkSize = dataSize - offset;
+	status = 2;
+	return 0;
+}
+
 void aifFile::WriteToFile(const char *, ByteBuffer *, int, unsigned int, int) {
 }
 
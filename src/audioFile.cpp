@@ -30,9 +30,80 @@
 #include "oamlCommon.h"
 
 
-audioFile::audioFile(oamlFileCallbacks *cbs) {
+audioFile::audioFile(oamlFileCallbacks2 *cbs) {
 	fcbs = cbs;
+
+	mapped = NULL;
+	dataOffset = 0;
+	dataSize = 0;
+
+	source = NULL;
 }
 
 audioFile::~audioFile() {
+	if (mapped) {
+		delete mapped;
+		mapped = NULL;
+	}
+
+	if (source) {
+		source->Release();
+		source = NULL;
+	}
+}
+
+void audioFile::SetSource(oamlMemoryFile *file) {
+	if (file) {
+		file->AddRef();
+	}
+
+	if (source) {
+		source->Release();
+	}
+
+	source = file;
+}
+
+bool audioFile::MapFile() {
+	// Only possible when the file callbacks know how to map
+	if (fcbs->map == NULL)
+		return false;
+
+	if (mapped == NULL) {
+		mapped = new oamlMappedFile();
+	}
+
+	if (mapped->Open(fcbs, fd) == false || dataOffset >= mapped->GetSize()) {
+		delete mapped;
+		mapped = NULL;
+		return false;
+	}
+
+	// Don't trust the header with the size, a truncated file just has less data
+	if (dataSize > mapped->GetSize() - dataOffset) {
+		dataSize = (unsigned int)(mapped->GetSize() - dataOffset);
+	}
+
+	return true;
+}
+
+size_t audioFile::ReadBytes(void *ptr, size_t bytes) {
+	if (fcbs->readInto) {
+		return fcbs->readInto(fd, ptr, bytes);
+	}
+
+	return fcbs->read(ptr, 1, bytes, fd);
+}
+
+const uint8_t* audioFile::GetMappedData() const {
+	if (mapped == NULL || GetPcmFormat() == OAML_PCM_NONE)
+		return NULL;
+
+	return mapped->GetData() + dataOffset;
+}
+
+oamlMappedFile* audioFile::DetachMapping() {
+	oamlMappedFile *map = mapped;
+	mapped = NULL;
+	return map;
 }
@@ -60,6 +60,10 @@ oamlRC oamlApi::InitString(const char *defs) {
 	return oaml->InitString(defs);
 }
 
+oamlRC oamlApi::CompileDefs(const char *defsFilename, const char *outFilename) {
+	return oaml->CompileDefs(defsFilename, outFilename);
+}
+
 void oamlApi::SetAudioFormat(int sampleRate, int channels, int bytesPerSample, bool floatBuffer) {
 	oaml->SetAudioFormat(sampleRate, channels, bytesPerSample, floatBuffer);
 }
@@ -92,14 +96,78 @@ oamlRC oamlApi::PlaySfx2d(const char *name, int x, int y, int width, int height)
 	return oaml->PlaySfx2d(name, x, y, width, height);
 }
 
+int oamlApi::GetTrackHandle(const char *name) {
+	return oaml->GetTrackHandle(name);
+}
+
+int oamlApi::GetSfxHandle(const char *name) {
+	return oaml->GetSfxHandle(name);
+}
+
+int oamlApi::GetLayerHandle(const char *layer) {
+	return oaml->GetLayerHandle(layer);
+}
+
+oamlRC oamlApi::PlayTrackHandle(int handle) {
+	return oaml->PlayTrackHandle(handle);
+}
+
+oamlRC oamlApi::PlaySfxHandle(int handle, float vol, float pan) {
+	return oaml->PlaySfxHandle(handle, vol, pan);
+}
+
+oamlRC oamlApi::LoadTrackHandle(int handle) {
+	return oaml->LoadTrackHandle(handle);
+}
+
+bool oamlApi::IsTrackPlayingHandle(int handle) {
+	return oaml->IsTrackPlayingHandle(handle);
+}
+
+void oamlApi::SetLayerGainHandle(int handle, float gain) {
+	oaml->SetLayerGainHandle(handle, gain);
+}
+
 oamlRC oamlApi::LoadTrack(const char *name) {
 	return oaml->LoadTrack(name);
 }
 
+oamlRC oamlApi::LoadTrackAsync(const char *name) {
+	return oaml->LoadTrackAsync(name);
+}
+
 float oamlApi::LoadTrackProgress(const char *name) {
 	return oaml->LoadTrackProgress(name);
 }
 
+void oamlApi::SetLoaderThreads(int count) {
+	oaml->SetLoaderThreads(count);
+}
+
+oamlRC oamlApi::PinTrack(const char *name) {
+	return oaml->PinTrack(name);
+}
+
+oamlRC oamlApi::UnpinTrack(const char *name) {
+	return oaml->UnpinTrack(name);
+}
+
+void oamlApi::SetCacheBudget(size_t bytes) {
+	oaml->SetCacheBudget(bytes);
+}
+
+size_t oamlApi::GetCacheMemoryUsage() {
+	return oaml->GetCacheMemoryUsage();
+}
+
+void oamlApi::SetStreamingThreshold(size_t bytes) {
+	oaml->SetStreamingThreshold(bytes);
+}
+
+void oamlApi::SetCompressedPlayback(bool enable) {
+	oaml->SetCompressedPlayback(enable);
+}
+
 bool oamlApi::IsTrackPlaying(const char *name) {
 	return oaml->IsTrackPlaying(name);
 }
@@ -180,6 +248,10 @@ void oamlApi::SetFileCallbacks(oamlFileCallbacks *cbs) {
 	oaml->SetFileCallbacks(cbs);
 }
 
+void oamlApi::SetFileCallbacks(oamlFileCallbacks2 *cbs) {
+	oaml->SetFileCallbacks(cbs);
+}
+
 void oamlApi::EnableDynamicCompressor(bool enable, double threshold, double ratio) {
 	oaml->EnableDynamicCompressor(enable, threshold, ratio);
 }
@@ -27,14 +27,16 @@
 #include <libgen.h>
 #endif
 #include <math.h>
+#include <limits.h>
 
 #include "oamlCommon.h"
 
 
-oamlAudio::oamlAudio(oamlFileCallbacks *cbs, bool _verbose) {
+oamlAudio::oamlAudio(oamlFileCallbacks2 *cbs, oamlSampleCache *_cache, bool _verbose) {
 	name = "";
 	verbose = _verbose;
 	fcbs = cbs;
+	cache = _cache;
 
 	type = 0;
 	bars = 0;
@@ -44,7 +46,7 @@ oamlAudio::oamlAudio(oamlFileCallbacks *cbs, bool _verbose) {
 	samplesPerSec = 0;
 	samplesToEnd = 0;
 	totalSamples = 0;
-	filesSamples = 0;
+	channelCount = 0;
 
 	bpm = 0;
 	beatsPerBar = 0;
@@ -66,11 +68,18 @@ oamlAudio::oamlAudio(oamlFileCallbacks *cbs, bool _verbose) {
 	condType = 0;
 	condValue = 0;
 	condValue2 = 0;
+	CompileCondition();
 
 	pickable = true;
 }
 
 oamlAudio::~oamlAudio() {
+	while (files.empty() == false) {
+		oamlAudioFile *file = files.back();
+		files.pop_back();
+
+		delete file;
+	}
 }
 
 void oamlAudio::SetCondition(int id, int type, int value, int value2) {
@@ -78,35 +87,39 @@ void oamlAudio::SetCondition(int id, int type, int value, int value2) {
 	condType = type;
 	condValue = value;
 	condValue2 = value2;
+	CompileCondition();
 }
 
-bool oamlAudio::TestCondition(int id, int value) {
-	if (id != condId)
-		return false;
+void oamlAudio::CompileCondition() {
+	// Start with an empty range, unknown types never match
+	condMin = INT_MAX;
+	condMax = INT_MIN;
 
 	switch (condType) {
 		case OAML_CONDTYPE_EQUAL:
-			if (value == condValue)
-				return true;
+			condMin = condValue;
+			condMax = condValue;
 			break;
 
 		case OAML_CONDTYPE_GREATER:
-			if (value > condValue)
-				return true;
+			if (condValue < INT_MAX) {
+				condMin = condValue + 1;
+				condMax = INT_MAX;
+			}
 			break;
 
 		case OAML_CONDTYPE_LESS:
-			if (value < condValue)
-				return true;
+			if (condValue > INT_MIN) {
+				condMin = INT_MIN;
+				condMax = condValue - 1;
+			}
 			break;
 
 		case OAML_CONDTYPE_RANGE:
-			if (value >= condValue && value <= condValue2)
-				return true;
+			condMin = condValue;
+			condMax = condValue2;
 			break;
 	}
-
-	return false;
 }
 
 unsigned int oamlAudio::GetBarsSamples(int bars) {
@@ -117,6 +130,33 @@ unsigned int oamlAudio::GetBarsSamples(int bars) {
 	return (unsigned int)(secs * samplesPerSec);
 }
 
+unsigned int oamlAudio::GetNextBarsPos(int bars) {
+	// Without a tempo there are no boundaries before the end
+	if (bars <= 0 || bpm <= 0 || beatsPerBar <= 0 || samplesPerSec == 0 || channelCount == 0)
+		return samplesToEnd;
+
+	// Beats are placed from the exact tempo so they don't drift over long audios
+	double framesPerBeat = (60.0 / bpm) * (samplesPerSec / channelCount);
+	if (framesPerBeat < 1.0)
+		return samplesToEnd;
+
+	// First beat starting after the current position, the estimate is nudged to undo any rounding
+	unsigned int frame = samplesCount / channelCount + 1;
+	double beat = ceil(frame / framesPerBeat);
+	while (beat > 0 && (unsigned int)((beat - 1) * framesPerBeat) >= frame) beat--;
+	while ((unsigned int)(beat * framesPerBeat) < frame) beat++;
+
+	// Then up to the next multiple of bars
+	double beats = double(bars) * beatsPerBar;
+	beat = ceil(beat / beats) * beats;
+
+	double pos = floor(beat * framesPerBeat) * channelCount;
+	if (pos >= samplesToEnd)
+		return samplesToEnd;
+
+	return (unsigned int)pos;
+}
+
 void oamlAudio::SetBPM(float _bpm) {
 	bpm = _bpm;
 
@@ -141,46 +181,24 @@ void oamlAudio::UpdateSamplesToEnd() {
 		samplesToEnd = totalSamples;
 	}
 
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		file->SetSamplesToEnd(samplesToEnd);
-	}
-}
-
-oamlRC oamlAudio::Load() {
-	oamlRC ret = Open();
-	if (ret != OAML_OK) return ret;
-
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		ret = file->Load();
-		if (ret != OAML_OK)
-			return ret;
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		(*file)->SetSamplesToEnd(samplesToEnd);
 	}
-
-	return OAML_OK;
 }
 
-int oamlAudio::LoadProgress() {
-	int ret = 0;
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		int count = file->LoadProgress();
-		if (count == -1)
-			return -1;
-
-		ret+= count;
-	}
-
-	return ret;
+void oamlAudio::GetAudioFiles(std::vector<oamlAudioFile*>& list) {
+	list.insert(list.end(), files.begin(), files.end());
 }
 
 void oamlAudio::GetAudioFileList(std::vector<std::string>& list) {
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		list.push_back(file->GetFilename());
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		list.push_back((*file)->GetFilename());
 	}
 }
 
-bool oamlAudio::HasAudioFile(std::string filename) {
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		if (file->GetFilename().compare(filename) == 0) {
+bool oamlAudio::HasAudioFile(const std::string& filename) {
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		if (filename.compare((*file)->GetFilenameStr()) == 0) {
 			return true;
 		}
 	}
@@ -188,37 +206,60 @@ bool oamlAudio::HasAudioFile(std::string filename) {
 	return false;
 }
 
-void oamlAudio::RemoveAudioFile(std::string filename) {
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		if (file->GetFilename().compare(filename) == 0) {
+void oamlAudio::RemoveAudioFile(const std::string& filename) {
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		if (filename.compare((*file)->GetFilenameStr()) == 0) {
+			delete *file;
 			files.erase(file);
 			return;
 		}
 	}
 }
 
-oamlAudioFile* oamlAudio::GetAudioFile(std::string filename) {
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		if (file->GetFilename().compare(filename) == 0) {
-			return &(*file);
+oamlAudioFile* oamlAudio::GetAudioFile(const std::string& filename) {
+	// Audios only have a few files, a scan is quicker than hashing
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		if (filename.compare((*file)->GetFilenameStr()) == 0) {
+			return *file;
 		}
 	}
 
 	return NULL;
 }
 
-oamlRC oamlAudio::Open() {
+oamlRC oamlAudio::Prepare() {
+	oamlRC rc = OAML_OK;
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		oamlRC ret = (*file)->Prepare();
+		if (ret != OAML_OK && rc == OAML_OK) {
+			rc = ret;
+		}
+	}
+
+	// Files take their reference even when they fail, give them all back
+	if (rc != OAML_OK) {
+		Unprepare();
+	}
+
+	return rc;
+}
+
+void oamlAudio::Unprepare() {
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		(*file)->Unprepare();
+	}
+}
+
+void oamlAudio::Open() {
 	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetName().c_str());
 
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		oamlRC ret = file->Open();
-		if (ret != OAML_OK)
-			return ret;
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		(*file)->Open();
 
 		if (totalSamples == 0) {
-			channelCount = file->GetChannels();
-			samplesPerSec = file->GetSamplesPerSec();
-			totalSamples = file->GetTotalSamples();
+			channelCount = (*file)->GetChannels();
+			samplesPerSec = (*file)->GetSamplesPerSec();
+			totalSamples = (*file)->GetTotalSamples();
 		}
 	}
 
@@ -234,8 +275,6 @@ oamlRC oamlAudio::Open() {
 		fadeOutSamples = 0;
 		fadeOutStart = 0;
 	}
-
-	return OAML_OK;
 }
 
 void oamlAudio::DoFadeIn(int msec) {
@@ -265,54 +304,111 @@ bool oamlAudio::HasFinishedTail(unsigned int pos) {
 	return pos >= totalSamples;
 }
 
-float oamlAudio::ReadFloat() {
-	float sample = 0.f;
+unsigned int oamlAudio::GetFramesToEnd() {
+	unsigned int end = samplesToEnd;
+	if (fadeOutSamples) {
+		unsigned int fadeOutFinish = fadeOutStart + fadeOutSamples;
+		if (fadeOutFinish < end) {
+			end = fadeOutFinish;
+		}
+	}
+
+	return GetFramesTo(end);
+}
+
+unsigned int oamlAudio::GetFramesTo(unsigned int pos) {
+	if (samplesCount >= pos)
+		return 0;
+
+	unsigned int samples = pos - samplesCount;
+	if (channelCount <= 1)
+		return samples;
+
+	// HasFinished is checked after every frame, so a partial frame still counts as a whole one
+	return (samples + channelCount - 1) / channelCount;
+}
+
+unsigned int oamlAudio::GetFramesToEndTail(unsigned int pos) {
+	if (pos >= totalSamples)
+		return 0;
+
+	unsigned int samples = totalSamples - pos;
+	if (channelCount <= 1)
+		return samples;
+
+	return (samples + channelCount - 1) / channelCount;
+}
 
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		sample+= file->ReadFloat(samplesCount);
+void oamlAudio::ReadFloats(float *samples, unsigned int count) {
+	memset(samples, 0, count * sizeof(float));
+
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		(*file)->ReadFloats(samples, samplesCount, count);
 	}
 
 	if (fadeInSamples) {
-		if (samplesCount < fadeInSamples) {
-			float gain = 1.f - float(fadeInSamples - samplesCount) / float(fadeInSamples);
-			sample*= gain;
-		} else {
+		unsigned int i = 0;
+		for (; i<count && samplesCount+i < fadeInSamples; i++) {
+			float gain = 1.f - float(fadeInSamples - (samplesCount+i)) / float(fadeInSamples);
+			samples[i]*= gain;
+		}
+
+		if (i < count) {
 			fadeInSamples = 0;
 		}
 	}
 
-	if (fadeOutSamples && samplesCount >= fadeOutStart) {
+	if (fadeOutSamples) {
+		// Only the part of the block inside the fade needs a gain, everything after it is silence
 		unsigned int fadeOutFinish = fadeOutStart + fadeOutSamples;
-		if (samplesCount < fadeOutFinish) {
-			float gain = float(fadeOutFinish - samplesCount) / float(fadeOutSamples);
-			sample*= gain;
-		} else {
-			sample = 0.f;
+		unsigned int i = fadeOutStart > samplesCount ? fadeOutStart - samplesCount : 0;
+		for (; i<count && samplesCount+i < fadeOutFinish; i++) {
+			float gain = float(fadeOutFinish - (samplesCount+i)) / float(fadeOutSamples);
+			samples[i]*= gain;
+		}
+
+		if (i < count) {
+			memset(samples + i, 0, (count - i) * sizeof(float));
 		}
 	}
 
-	samplesCount++;
+	samplesCount+= count;
 
-	return sample * volume;
+	if (volume != 1.f) {
+		for (unsigned int i=0; i<count; i++) {
+			samples[i]*= volume;
+		}
+	}
 }
 
-float oamlAudio::ReadFloat(unsigned int pos) {
-	float sample = 0.f;
+void oamlAudio::ReadFloats(float *samples, unsigned int count, unsigned int pos) {
+	memset(samples, 0, count * sizeof(float));
 
-	if (pos > totalSamples)
-		return 0;
+	if (pos >= totalSamples)
+		return;
+
+	if (pos + count > totalSamples) {
+		count = totalSamples - pos;
+	}
 
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-		sample+= file->ReadFloat(pos, true);
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+		(*file)->ReadFloats(samples, pos, count, true);
 	}
 
-	return sample * volume;
+	if (volume != 1.f) {
+		for (unsigned int i=0; i<count; i++) {
+			samples[i]*= volume;
+		}
+	}
 }
 
-void oamlAudio::AddAudioFile(std::string filename, std::string layer, int randomChance) {
-	oamlAudioFile file = oamlAudioFile(filename, fcbs, verbose);
-	file.SetLayer(layer);
-	file.SetRandomChance(randomChance);
+void oamlAudio::AddAudioFile(std::string filename, std::string layer, int randomChance, bool stream) {
+	oamlAudioFile *file = new oamlAudioFile(filename, fcbs, cache, verbose);
+	file->SetLayer(layer);
+	file->SetRandomChance(randomChance);
+	if (stream) {
+		file->SetStreaming();
+	}
 
 	files.push_back(file);
 
@@ -328,76 +424,66 @@ void oamlAudio::AddAudioFile(std::string filename, std::string layer, int random
 	}
 }
 
-void oamlAudio::ReadSamples(float *samples, int channels) {
+void oamlAudio::ConvertChannels(const float *src, float *dst, int frames, int channels) {
 	if (channelCount == 1) {
 		// Mono audio to mono/stereo output
-		float sample = ReadFloat();
-
-		for (int i=0; i<channels; i++) {
-			samples[i] = sample;
-		}
-	} else if (channelCount == 2) {
-		if (channels == 1) {
-			// Stereo audio to mono output
-			float left = ReadFloat();
-			float right = ReadFloat();
-
-			samples[0] = left * 0.5f + right + 0.5f;
-		} else if (channels == 2) {
-			// Stereo audio to stereo output
-			for (int i=0; i<channels; i++) {
-				samples[i] = ReadFloat();
+		for (int i=0; i<frames; i++) {
+			for (int c=0; c<channels; c++) {
+				dst[i*channels+c] = src[i];
 			}
 		}
+	} else if (channelCount == 2 && channels == 1) {
+		// Stereo audio to mono output
+		for (int i=0; i<frames; i++) {
+			dst[i] = (src[i*2+0] + src[i*2+1]) * 0.5f;
+		}
+	} else {
+		memset(dst, 0, frames * channels * sizeof(float));
 	}
 }
 
-unsigned int oamlAudio::ReadSamples(float *samples, int channels, unsigned int pos) {
-	if (channelCount == 1) {
-		float sample = ReadFloat(pos++);
+void oamlAudio::ReadSamples(float *samples, int frames, int channels) {
+	if ((int)channelCount == channels) {
+		ReadFloats(samples, frames * channels);
+		return;
+	}
 
-		for (int i=0; i<channels; i++) {
-			samples[i] = sample;
-		}
-	} else if (channelCount == 2) {
-		if (channels == 1) {
-			float left = ReadFloat(pos++);
-			float right = ReadFloat(pos++);
-
-			samples[0] = left * 0.5f + right + 0.5f;
-		} else if (channels == 2) {
-			for (int i=0; i<channels; i++) {
-				samples[i] = ReadFloat(pos++);
-			}
-		}
+	unsigned int count = frames * channelCount;
+	if (buffer.size() < count) {
+		buffer.resize(count);
 	}
 
-	return pos;
+	if (count > 0) {
+		ReadFloats(&buffer[0], count);
+	}
+	ConvertChannels(buffer.empty() ? NULL : &buffer[0], samples, frames, channels);
 }
 
-void oamlAudio::FreeMemory() {
-	for (std::vector<oamlAudioFile>::iterator layer=files.begin(); layer<files.end(); ++layer) {
-		layer->FreeMemory();
+unsigned int oamlAudio::ReadSamples(float *samples, int frames, int channels, unsigned int pos) {
+	if ((int)channelCount == channels) {
+		ReadFloats(samples, frames * channels, pos);
+		return pos + frames * channels;
+	}
+
+	unsigned int count = frames * channelCount;
+	if (buffer.size() < count) {
+		buffer.resize(count);
 	}
 
+	if (count > 0) {
+		ReadFloats(&buffer[0], count, pos);
+	}
+	ConvertChannels(buffer.empty() ? NULL : &buffer[0], samples, frames, channels);
+
+	return pos + count;
+}
+
+// Done playing, files and streams are kept until the play that prepared them gives them back
+void oamlAudio::Release() {
 	samplesCount = 0;
 	samplesPerSec = 0;
 	samplesToEnd = 0;
 	totalSamples = 0;
-	filesSamples = 0;
-}
-
-unsigned int oamlAudio::GetFilesSamples() {
-	if (filesSamples == 0) {
-		oamlRC ret = Open();
-		if (ret != OAML_OK) return ret;
-
-		for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
-			filesSamples+= file->GetTotalSamples();
-		}
-	}
-
-	return filesSamples;
 }
 
 void oamlAudio::ReadInfo(oamlAudioInfo *info) {
@@ -419,12 +505,12 @@ void oamlAudio::ReadInfo(oamlAudioInfo *info) {
 	info->condValue = GetCondValue();
 	info->condValue2 = GetCondValue2();
 
-	for (std::vector<oamlAudioFile>::iterator file=files.begin(); file<files.end(); ++file) {
+	for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
 		oamlAudioFileInfo afinfo;
 
-		afinfo.filename = file->GetFilename();
-		afinfo.layer = file->GetLayer();
-		afinfo.randomChance = file->GetRandomChance();
+		afinfo.filename = (*file)->GetFilename();
+		afinfo.layer = (*file)->GetLayer();
+		afinfo.randomChance = (*file)->GetRandomChance();
 
 		info->files.push_back(afinfo);
 	}
@@ -27,176 +27,204 @@
 #include "oamlCommon.h"
 
 
-oamlAudioFile::oamlAudioFile(std::string _filename, oamlFileCallbacks *cbs, bool _verbose) {
+oamlAudioFile::oamlAudioFile(std::string _filename, oamlFileCallbacks2 *cbs, oamlSampleCache *_cache, bool _verbose) {
 	filename = _filename;
 	layer = "";
 	randomChance = -1;
 	gain = 1.f;
-	fcbs = cbs;
+	cache = _cache;
 	verbose = _verbose;
 
-	handle = NULL;
+	// Files with the same name share their decoded samples
+	sample = cache->Acquire(filename, cbs, verbose);
 
-	bytesPerSample = 0;
-	samplesPerSec = 0;
-	totalSamples = 0;
-	channelCount = 0;
+	samplesToEnd = 0;
 
 	chance = false;
 	lastChance = false;
-}
+	pinned = false;
+	prepared = 0;
 
-oamlAudioFile::~oamlAudioFile() {
-	if (handle) {
-		delete handle;
-		handle = NULL;
+	for (int i=0; i<2; i++) {
+		streams[i] = NULL;
+		streamReads[i] = 0;
 	}
+	readsCount = 0;
 }
 
-oamlRC oamlAudioFile::OpenFile() {
-	std::string ext = filename.substr(filename.find_last_of(".") + 1);
-	if (ext == "wav" || ext == "wave") {
-		handle = new wavFile(fcbs);
-	} else if (ext == "aif" || ext == "aiff") {
-		handle = (audioFile*)new aifFile(fcbs);
-#ifdef __HAVE_OGG
-	} else if (ext == "ogg") {
-		handle = (audioFile*)new oggFile(fcbs);
-#endif
-	} else {
-		fprintf(stderr, "liboaml: Unknown audio format: '%s'\n", GetFilenameStr());
-		return OAML_ERROR;
+oamlAudioFile::~oamlAudioFile() {
+	while (prepared > 0) {
+		prepared--;
+		sample->RemoveUser();
 	}
 
-	if (handle->Open(GetFilenameStr()) == -1) {
-		fprintf(stderr, "liboaml: Error opening: '%s'\n", GetFilenameStr());
-		return OAML_ERROR;
+	CloseStreams();
+
+	if (pinned) {
+		sample->Unpin();
 	}
 
-	bytesPerSample = handle->GetBytesPerSample();
-	samplesPerSec = handle->GetSamplesPerSec() * handle->GetChannels();
-	totalSamples = handle->GetTotalSamples();
-	channelCount = handle->GetChannels();
+	cache->Release(sample);
+	sample = NULL;
+}
+
+oamlRC oamlAudioFile::Prepare() {
+	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetFilenameStr());
+
+	// Mark it as used first, so the cache won't evict it from under us
+	sample->AddUser();
+	prepared++;
+	cache->Touch(sample);
+
+	oamlRC rc = sample->Open();
+	if (rc != OAML_OK)
+		return rc;
+
+	if (sample->IsStreaming()) {
+		OpenStreams();
+	}
 
 	return OAML_OK;
 }
 
-oamlRC oamlAudioFile::Open() {
-	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetFilenameStr());
-	if (buffer.size() == 0) {
-		oamlRC rc = OpenFile();
-		if (rc != OAML_OK) return rc;
+void oamlAudioFile::Unprepare() {
+	if (prepared <= 0)
+		return;
+
+	// Decoded data is kept around, oamlSampleCache evicts it when it needs the memory
+	if (--prepared == 0) {
+		CloseStreams();
 	}
+	cache->Touch(sample);
+	sample->RemoveUser();
+}
 
+void oamlAudioFile::Open() {
 	if (GetRandomChance() != -1) {
 		chance = __oamlRandom(0, 100) > GetRandomChance();
 	} else {
 		lastChance = true;
 		chance = true;
 	}
-
-	return OAML_OK;
 }
 
 oamlRC oamlAudioFile::Load() {
-	int ret;
-	do {
-		ret = Read();
-	} while (ret > 0);
+	oamlRC rc = sample->Load();
 
-	if (ret == -1) return OAML_ERROR;
-	return OAML_OK;
-}
+	// Count loading as a use, then make room for it if we went over budget
+	cache->Touch(sample);
+	cache->Trim();
 
-int oamlAudioFile::LoadProgress() {
-	if (handle == NULL) {
-		return buffer.size()/bytesPerSample;
-	}
+	return rc;
+}
 
-	int ret = Read();
-	if (ret == -1) {
-		return -1;
-	}
+float oamlAudioFile::LoadProgress() {
+	return sample->LoadProgress();
+}
 
-	return buffer.size()/bytesPerSample;
+bool oamlAudioFile::IsLoaded() {
+	return sample->IsLoaded();
 }
 
-int oamlAudioFile::Read() {
-	if (handle == NULL)
-		return -1;
+void oamlAudioFile::ReadFloats(float *samples, unsigned int pos, unsigned int count, bool isTail) {
+	if (isTail) {
+		if (lastChance == false)
+			return;
+	} else {
+		if (samplesToEnd > 0 && samplesToEnd-1 >= pos && samplesToEnd-1 < pos+count) {
+			lastChance = chance;
+		}
 
-	int readSize = 4096*bytesPerSample;
-	int ret = handle->Read(&buffer, readSize);
-	if (ret < readSize) {
-		handle->Close();
-		delete handle;
-		handle = NULL;
+		if (chance == false)
+			return;
 	}
 
-	return ret;
+	if (sample->IsStreaming()) {
+		ReadStream(samples, pos, count);
+	} else {
+		sample->Mix(samples, pos, count, GetGain());
+	}
 }
 
-int oamlAudioFile::Read32(unsigned int pos) {
-	int ret = 0;
-
-	if (pos > totalSamples)
-		return 0;
-
-	pos*= bytesPerSample;
-	while ((pos+bytesPerSample) > buffer.size()) {
-		if (Read() == -1)
-			return 0;
+oamlStream* oamlAudioFile::GetStream(unsigned int pos) {
+	oamlStream *stream[2] = { streams[0].load(), streams[1].load() };
+	for (int i=0; i<2; i++) {
+		if (stream[i] && stream[i]->GetNextPos() == pos) {
+			streamReads[i] = ++readsCount;
+			return stream[i];
+		}
 	}
 
-	if (bytesPerSample == 3) {
-		ret|= ((unsigned int)buffer.get(pos))<<8;
-		ret|= ((unsigned int)buffer.get(pos+1))<<16;
-		ret|= ((unsigned int)buffer.get(pos+2))<<24;
-	} else if (bytesPerSample == 2) {
-		ret|= ((unsigned int)buffer.get(pos))<<16;
-		ret|= ((unsigned int)buffer.get(pos+1))<<24;
-	} else if (bytesPerSample == 1) {
-		ret|= ((unsigned int)buffer.get(pos))<<23;
+	// Nobody is reading from here, take the stream read least recently as the other one may still be playing a tail
+	int i = 0;
+	if (stream[0] && (stream[1] == NULL || streamReads[1] < streamReads[0])) {
+		i = 1;
 	}
 
-	return ret;
-}
+	// Not prepared as a streamed file, play silence rather than open anything here
+	if (stream[i] == NULL)
+		return NULL;
 
-float oamlAudioFile::ReadFloat(unsigned int pos, bool isTail) {
-	if (isTail) {
-		if (lastChance == false)
-			return 0.f;
-	} else {
-		if (pos == (samplesToEnd-1)) {
-			lastChance = chance;
-		}
+	streamReads[i] = ++readsCount;
+	return stream[i];
+}
 
-		if (chance == false)
-			return 0.f;
+void oamlAudioFile::ReadStream(float *samples, unsigned int pos, unsigned int count) {
+	// The start of the file is played from memory, the stream takes over where the decoded head ends
+	unsigned int resident = sample->GetResidentSamples();
+	if (pos < resident) {
+		unsigned int headCount = resident - pos;
+		if (headCount > count) headCount = count;
+		sample->Mix(samples, pos, headCount, GetGain());
 	}
 
-	float sample = __oamlInteger24ToFloat(Read32(pos)>>8);
-	if (GetGain() != 1.f) {
-		sample*= GetGain();
+	oamlStream *stream = GetStream(pos);
+	if (stream) {
+		stream->Read(samples, pos, count, GetGain(), resident);
 	}
-	return sample;
 }
 
-void oamlAudioFile::FreeMemory() {
-	if (buffer.size() > 0 || handle != NULL) {
-		if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetFilenameStr());
+void oamlAudioFile::OpenStreams() {
+	for (int i=0; i<2; i++) {
+		if (streams[i].load())
+			continue;
+
+		oamlStream *stream = sample->CreateStream();
+		cache->GetStreamer()->Add(stream);
+
+		// Someone else may have filled the slot in the meantime, oamlStreamer deletes ours once closed
+		oamlStream *expected = NULL;
+		if (streams[i].compare_exchange_strong(expected, stream) == false) {
+			stream->Close();
+		}
 	}
+}
 
-	buffer.clear();
-	buffer.free();
+void oamlAudioFile::CloseStreams() {
+	// Closing is just a flag, oamlStreamer deletes them once it's done with them
+	for (int i=0; i<2; i++) {
+		oamlStream *stream = streams[i].exchange(NULL);
+		if (stream == NULL)
+			continue;
+
+		// Prepared again while we were at it, put it back unless a new one took the slot
+		oamlStream *expected = NULL;
+		if (prepared.load() > 0 && streams[i].compare_exchange_strong(expected, stream)) {
+			continue;
+		}
 
-	if (handle) {
-		delete handle;
-		handle = NULL;
+		stream->Close();
 	}
+}
 
-	bytesPerSample = 0;
-	samplesPerSec = 0;
-	totalSamples = 0;
-	channelCount = 0;
+void oamlAudioFile::SetPinned(bool pin) {
+	if (pin == pinned)
+		return;
+
+	if (pin) {
+		sample->Pin();
+	} else {
+		sample->Unpin();
+	}
+	pinned = pin;
 }
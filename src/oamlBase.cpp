@@ -53,13 +53,32 @@ static int oamlClose(void *fd) {
 	return fclose((FILE*)fd);
 }
 
+static long oamlSize(void *fd) {
+	FILE *f = (FILE*)fd;
+	long pos = ftell(f);
+	if (fseek(f, 0, SEEK_END) != 0)
+		return -1;
+
+	long size = ftell(f);
+	fseek(f, pos, SEEK_SET);
+	return size;
+}
+
+static size_t oamlReadInto(void *fd, void *buffer, size_t bytes) {
+	return fread(buffer, 1, bytes, (FILE*)fd);
+}
+
 
-static oamlFileCallbacks defCbs = {
+static oamlFileCallbacks2 defCbs = {
 	&oamlOpen,
 	&oamlRead,
 	&oamlSeek,
 	&oamlTell,
-	&oamlClose
+	&oamlClose,
+	&oamlSize,
+	&oamlMappedFile::MapStdioFile,
+	&oamlMappedFile::UnmapStdioFile,
+	&oamlReadInto
 };
 
 oamlBase::oamlBase() {
@@ -84,6 +103,8 @@ oamlBase::oamlBase() {
 	sampleRate = 0;
 	channels = 0;
 	bytesPerSample = 0;
+	floatBuffer = false;
+	mixKernel = NULL;
 
 	volume = OAML_VOLUME_DEFAULT;
 	pause = false;
@@ -93,6 +114,7 @@ oamlBase::oamlBase() {
 	tensionMs = 0;
 
 	fcbs = &defCbs;
+	memset(&userCbs, 0, sizeof(userCbs));
 }
 
 oamlBase::~oamlBase() {
@@ -157,12 +179,15 @@ oamlRC oamlBase::InitAudioDevice(int sampleRate, int channels) {
 }
 
 oamlRC oamlBase::ReadAudioDefs(tinyxml2::XMLElement *el, oamlTrack *track) {
-	oamlAudio *audio = new oamlAudio(fcbs, verbose);
+	oamlAudio *audio = new oamlAudio(fcbs, &samples, verbose);
 
 	tinyxml2::XMLElement *audioEl = el->FirstChildElement();
 	while (audioEl != NULL) {
 		if (strcmp(audioEl->Name(), "name") == 0) audio->SetName(audioEl->GetText());
 		else if (strcmp(audioEl->Name(), "filename") == 0) {
+			const char *streamAttr = audioEl->Attribute("stream");
+			bool stream = streamAttr ? strtol(streamAttr, NULL, 0) != 0 : false;
+
 			const char *layer = audioEl->Attribute("layer");
 			if (layer) {
 				const char *randomChanceAttr = audioEl->Attribute("randomChance");
@@ -172,9 +197,9 @@ oamlRC oamlBase::ReadAudioDefs(tinyxml2::XMLElement *el, oamlTrack *track) {
 					AddLayer(layer);
 				}
 
-				audio->AddAudioFile(audioEl->GetText(), layer, randomChance);
+				audio->AddAudioFile(audioEl->GetText(), layer, randomChance, stream);
 			} else {
-				audio->AddAudioFile(audioEl->GetText());
+				audio->AddAudioFile(audioEl->GetText(), "", -1, stream);
 			}
 		} else if (strcmp(audioEl->Name(), "type") == 0) audio->SetType(strtol(audioEl->GetText(), NULL, 0));
 		else if (strcmp(audioEl->Name(), "bars") == 0) audio->SetBars(strtol(audioEl->GetText(), NULL, 0));
@@ -200,10 +225,8 @@ oamlRC oamlBase::ReadAudioDefs(tinyxml2::XMLElement *el, oamlTrack *track) {
 	}
 
 	if (audio->GetName() == "" || track->GetAudio(audio->GetName())) {
-		std::vector<std::string> list;
-		track->GetAudioList(list);
 		char name[256];
-		snprintf(name, sizeof(name), "audio%d", (int)list.size());
+		snprintf(name, sizeof(name), "audio%d", track->GetAudiosCount());
 		audio->SetName(name);
 	}
 
@@ -241,16 +264,23 @@ oamlRC oamlBase::ReadTrackDefs(tinyxml2::XMLElement *el) {
 		trackEl = trackEl->NextSiblingElement();
 	}
 
+	// Not playing yet, so the conditions can be indexed from here
+	track->ReindexConditions();
 	if (track->IsMusicTrack()) {
 		musicTracks.push_back(track);
 	} else {
 		sfxTracks.push_back(track);
 	}
+	IndexTrack(track);
 
 	return OAML_OK;
 }
 
 oamlRC oamlBase::ReadDefs(const char *buf, int size) {
+	if (oamlBinaryDefs::IsBinaryDefs(buf, size)) {
+		return ReadBinaryDefs(buf, size);
+	}
+
 	tinyxml2::XMLDocument doc;
 	tinyxml2::XMLError err = doc.Parse(buf, size);
 	if (err != tinyxml2::XML_NO_ERROR) {
@@ -290,6 +320,200 @@ oamlRC oamlBase::ReadDefs(const char *buf, int size) {
 	return OAML_OK;
 }
 
+oamlRC oamlBase::ReadBinaryDefs(const char *buf, int size) {
+	oamlBinaryDefs defs;
+	if (defs.Open(buf, size) != OAML_OK) {
+		fprintf(stderr, "liboaml: Error reading compiled definitions\n");
+		return OAML_ERROR;
+	}
+
+	ProjectSetBPM(defs.GetFloat());
+	ProjectSetBeatsPerBar(defs.GetInt());
+
+	int layersCount = defs.GetInt();
+	for (int i=0; i<layersCount && defs.HasError() == false; i++) {
+		AddLayer(defs.GetString());
+	}
+
+	int tracksCount = defs.GetInt();
+	for (int i=0; i<tracksCount && defs.HasError() == false; i++) {
+		// Added right away so it's freed by Clear() if the rest turns out to be corrupt
+		oamlTrack *track;
+		if (defs.GetInt()) {
+			track = new oamlSfxTrack(verbose);
+			sfxTracks.push_back(track);
+		} else {
+			track = new oamlMusicTrack(verbose);
+			musicTracks.push_back(track);
+		}
+
+		track->SetName(defs.GetString());
+		int groupsCount = defs.GetInt();
+		for (int j=0; j<groupsCount && defs.HasError() == false; j++) {
+			track->AddGroup(defs.GetString());
+		}
+		int subgroupsCount = defs.GetInt();
+		for (int j=0; j<subgroupsCount && defs.HasError() == false; j++) {
+			track->AddSubgroup(defs.GetString());
+		}
+		track->SetFadeIn(defs.GetInt());
+		track->SetFadeOut(defs.GetInt());
+		track->SetXFadeIn(defs.GetInt());
+		track->SetXFadeOut(defs.GetInt());
+		track->SetVolume(defs.GetFloat());
+
+		int audiosCount = defs.GetInt();
+		for (int j=0; j<audiosCount && defs.HasError() == false; j++) {
+			oamlAudio *audio = new oamlAudio(fcbs, &samples, verbose);
+
+			audio->SetName(defs.GetString());
+			audio->SetType(defs.GetInt());
+			audio->SetBars(defs.GetInt());
+			audio->SetVolume(defs.GetFloat());
+			audio->SetBPM(defs.GetFloat());
+			audio->SetBeatsPerBar(defs.GetInt());
+			audio->SetMinMovementBars(defs.GetInt());
+			audio->SetRandomChance(defs.GetInt());
+			audio->SetPlayOrder(defs.GetInt());
+			audio->SetFadeIn(defs.GetInt());
+			audio->SetFadeOut(defs.GetInt());
+			audio->SetXFadeIn(defs.GetInt());
+			audio->SetXFadeOut(defs.GetInt());
+			audio->SetCondId(defs.GetInt());
+			audio->SetCondType(defs.GetInt());
+			audio->SetCondValue(defs.GetInt());
+			audio->SetCondValue2(defs.GetInt());
+
+			int filesCount = defs.GetInt();
+			for (int k=0; k<filesCount && defs.HasError() == false; k++) {
+				std::string filename = defs.GetString();
+				std::string layer = defs.GetString();
+				int randomChance = defs.GetInt();
+				bool stream = defs.GetInt() != 0;
+
+				// Header values probed when compiling, the file isn't opened until it's needed
+				oamlFileInfo info;
+				info.channels = defs.GetInt();
+				info.samplesPerSec = defs.GetInt();
+				info.totalSamples = defs.GetInt();
+				info.bytesPerSample = defs.GetInt();
+				info.pcmFormat = defs.GetInt();
+				info.fileSize = (unsigned int)defs.GetInt();
+				samples.SetInfo(filename, info);
+
+				audio->AddAudioFile(filename, layer, randomChance, stream);
+			}
+
+			track->AddAudio(audio);
+		}
+
+		// It can't be playing until this returns, so the conditions can be indexed from here
+		track->ReindexConditions();
+	}
+
+	// Tracks go in before their names are read, index them all at once
+	IndexTracks();
+
+	if (defs.HasError()) {
+		fprintf(stderr, "liboaml: Compiled definitions are truncated or corrupt\n");
+		return OAML_ERROR;
+	}
+
+	return OAML_OK;
+}
+
+oamlRC oamlBase::WriteBinaryDefs(const char *filename) {
+	oamlBinaryDefs defs;
+
+	defs.PutFloat(bpm);
+	defs.PutInt(beatsPerBar);
+
+	defs.PutInt((int)layers.size());
+	for (std::vector<oamlLayer*>::iterator it=layers.begin(); it<layers.end(); ++it) {
+		defs.PutString((*it)->GetName());
+	}
+
+	std::vector<oamlTrack*> tracks(musicTracks);
+	tracks.insert(tracks.end(), sfxTracks.begin(), sfxTracks.end());
+
+	defs.PutInt((int)tracks.size());
+	for (std::vector<oamlTrack*>::iterator it=tracks.begin(); it<tracks.end(); ++it) {
+		oamlTrack *track = *it;
+
+		defs.PutInt(track->IsSfxTrack() ? 1 : 0);
+		defs.PutString(track->GetName());
+		std::vector<std::string> groups = track->GetGroups();
+		defs.PutInt((int)groups.size());
+		for (std::vector<std::string>::iterator group=groups.begin(); group<groups.end(); ++group) {
+			defs.PutString(*group);
+		}
+		std::vector<std::string> subgroups = track->GetSubgroups();
+		defs.PutInt((int)subgroups.size());
+		for (std::vector<std::string>::iterator subgroup=subgroups.begin(); subgroup<subgroups.end(); ++subgroup) {
+			defs.PutString(*subgroup);
+		}
+		defs.PutInt(track->GetFadeIn());
+		defs.PutInt(track->GetFadeOut());
+		defs.PutInt(track->GetXFadeIn());
+		defs.PutInt(track->GetXFadeOut());
+		defs.PutFloat(track->GetVolume());
+
+		std::vector<std::string> audios;
+		track->GetAudioList(audios);
+		defs.PutInt((int)audios.size());
+		for (std::vector<std::string>::iterator name=audios.begin(); name<audios.end(); ++name) {
+			oamlAudio *audio = track->GetAudio(*name);
+
+			defs.PutString(audio->GetName());
+			defs.PutInt(audio->GetType());
+			defs.PutInt(audio->GetBars());
+			defs.PutFloat(audio->GetVolume());
+			defs.PutFloat(audio->GetBPM());
+			defs.PutInt(audio->GetBeatsPerBar());
+			defs.PutInt(audio->GetMinMovementBars());
+			defs.PutInt(audio->GetRandomChance());
+			defs.PutInt(audio->GetPlayOrder());
+			defs.PutInt(audio->GetFadeIn());
+			defs.PutInt(audio->GetFadeOut());
+			defs.PutInt(audio->GetXFadeIn());
+			defs.PutInt(audio->GetXFadeOut());
+			defs.PutInt(audio->GetCondId());
+			defs.PutInt(audio->GetCondType());
+			defs.PutInt(audio->GetCondValue());
+			defs.PutInt(audio->GetCondValue2());
+
+			std::vector<oamlAudioFile*> files;
+			audio->GetAudioFiles(files);
+			defs.PutInt((int)files.size());
+			for (std::vector<oamlAudioFile*>::iterator file=files.begin(); file<files.end(); ++file) {
+				defs.PutString((*file)->GetFilename());
+				defs.PutString((*file)->GetLayer());
+				defs.PutInt((*file)->GetRandomChance());
+				defs.PutInt((*file)->IsStreamRequested() ? 1 : 0);
+
+				// Store the header too so loading the compiled defs doesn't have to probe it, missing files are stored as unknown
+				oamlFileInfo info;
+				if (samples.GetInfo((*file)->GetFilename(), &info) == false) {
+					if (oamlSample::ProbeInfo((*file)->GetFilenameStr(), fcbs, &info)) {
+						samples.StoreInfo((*file)->GetFilename(), info);
+					} else {
+						memset(&info, 0, sizeof(info));
+					}
+				}
+
+				defs.PutInt(info.channels);
+				defs.PutInt(info.samplesPerSec);
+				defs.PutInt(info.totalSamples);
+				defs.PutInt(info.bytesPerSample);
+				defs.PutInt(info.pcmFormat);
+				defs.PutInt((int)info.fileSize);
+			}
+		}
+	}
+
+	return defs.Save(filename);
+}
+
 void oamlBase::ReadInternalDefs(const char *filename) {
 	tinyxml2::XMLDocument doc;
 
@@ -345,6 +569,29 @@ oamlRC oamlBase::ReadDefsFile(const char *defsFilename) {
 		return OAML_ERROR;
 	}
 
+	// Parse the definitions in place if the file can be mapped
+	oamlMappedFile map;
+	if (map.Open(fcbs, fd)) {
+		fcbs->close(fd);
+		return ReadDefs((const char*)map.GetData(), (int)map.GetSize());
+	}
+
+	// Otherwise read it whole into a single buffer when we know the size up front
+	long size = fcbs->size ? fcbs->size(fd) : -1;
+	if (size > 0) {
+		std::vector<char> data(size);
+		size_t bytes = 0;
+		while (bytes < (size_t)size) {
+			size_t ret = fcbs->readInto ? fcbs->readInto(fd, &data[bytes], size - bytes) : fcbs->read(&data[bytes], 1, size - bytes, fd);
+			if (ret == 0)
+				break;
+			bytes+= ret;
+		}
+		fcbs->close(fd);
+
+		return ReadDefs(&data[0], (int)bytes);
+	}
+
 	uint8_t buffer[4096];
 	size_t bytes;
 	do {
@@ -374,27 +621,70 @@ oamlRC oamlBase::InitString(const char *defs) {
 	return ReadDefs(defs, strlen(defs));
 }
 
+oamlRC oamlBase::CompileDefs(const char *defsFilename, const char *outFilename) {
+	ASSERT(defsFilename != NULL);
+	ASSERT(outFilename != NULL);
+
+	if (verbose) __oamlLog("%s: %s -> %s\n", __FUNCTION__, defsFilename, outFilename);
+
+	// The project is left loaded, same as after Init()
+	oamlRC ret = Init(defsFilename);
+	if (ret != OAML_OK) return ret;
+
+	return WriteBinaryDefs(outFilename);
+}
+
 void oamlBase::SetAudioFormat(int audioSampleRate, int audioChannels, int audioBytesPerSample, bool audioFloatBuffer) {
 	sampleRate = audioSampleRate;
 	channels = audioChannels;
 	bytesPerSample = audioBytesPerSample;
 	floatBuffer = audioFloatBuffer;
 
+	// Files at any other rate are converted to this one as they're decoded
+	samples.SetOutputRate(sampleRate > 0 ? (unsigned int)sampleRate : 0);
+
 	if (useCompressor) {
 		compressor.SetAudioFormat(channels, sampleRate);
 	}
+
+	SelectMixKernel();
+}
+
+oamlRC oamlBase::QueuePlayTrack(oamlTrack *track) {
+	// Files are opened here rather than on the audio thread, so errors can be returned right away
+	oamlRC rc = track->Prepare();
+	if (rc != OAML_OK)
+		return rc;
+
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_PLAY_TRACK;
+	cmd.track = track;
+	commands.Push(cmd);
+
+	return OAML_OK;
+}
+
+oamlRC oamlBase::QueuePlaySfx(oamlTrack *track, oamlAudio *audio, float vol, float pan) {
+	oamlRC rc = audio->Prepare();
+	if (rc != OAML_OK)
+		return rc;
+
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_PLAY_SFX;
+	cmd.track = track;
+	cmd.audio = audio;
+	cmd.vol = vol;
+	cmd.pan = pan;
+	commands.Push(cmd);
+
+	return OAML_OK;
 }
 
 oamlRC oamlBase::PlayTrackId(int id) {
 	if (id >= (int)musicTracks.size())
 		return OAML_ERROR;
 
-	if (curTrack) {
-		curTrack->Stop();
-	}
-
-	curTrack = musicTracks[id];
-	return curTrack->Play();
+	return QueuePlayTrack(musicTracks[id]);
 }
 
 oamlRC oamlBase::PlayTrack(const char *name) {
@@ -402,16 +692,11 @@ oamlRC oamlBase::PlayTrack(const char *name) {
 
 	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, name);
 
-	for (std::vector<oamlTrack*>::iterator it=musicTracks.begin(); it<musicTracks.end(); ++it) {
-		oamlTrack *track = *it;
-		if (track->GetName().compare(name) == 0) {
-			if (curTrack) curTrack->Stop();
-			curTrack = track;
-			return curTrack->Play();
-		}
-	}
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL || track->IsMusicTrack() == false)
+		return OAML_ERROR;
 
-	return OAML_ERROR;
+	return QueuePlayTrack(track);
 }
 
 oamlRC oamlBase::PlaySfx(const char *name) {
@@ -425,8 +710,9 @@ oamlRC oamlBase::PlaySfxEx(const char *name, float vol, float pan) {
 
 	for (std::vector<oamlTrack*>::iterator it=sfxTracks.begin(); it<sfxTracks.end(); ++it) {
 		oamlTrack *track = *it;
-		if (track->Play(name, vol, pan) == 0) {
-			return OAML_OK;
+		oamlAudio *audio = track->GetAudio(name);
+		if (audio) {
+			return QueuePlaySfx(track, audio, vol, pan);
 		}
 	}
 
@@ -455,6 +741,117 @@ oamlRC oamlBase::PlaySfx2d(const char *name, int x, int y, int width, int height
 	return PlaySfxEx(name, vol, pan);
 }
 
+int oamlBase::GetTrackHandle(const char *name) {
+	ASSERT(name != NULL);
+
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL)
+		return -1;
+
+	for (size_t i=0; i<trackHandles.size(); i++) {
+		if (trackHandles[i] == track) {
+			return (int)i;
+		}
+	}
+
+	trackHandles.push_back(track);
+	return (int)trackHandles.size() - 1;
+}
+
+int oamlBase::GetSfxHandle(const char *name) {
+	ASSERT(name != NULL);
+
+	for (std::vector<oamlTrack*>::iterator it=sfxTracks.begin(); it<sfxTracks.end(); ++it) {
+		oamlTrack *track = *it;
+		oamlAudio *audio = track->GetAudio(name);
+		if (audio == NULL)
+			continue;
+
+		for (size_t i=0; i<sfxHandles.size(); i++) {
+			if (sfxHandles[i].second == audio) {
+				return (int)i;
+			}
+		}
+
+		sfxHandles.push_back(std::make_pair(track, audio));
+		return (int)sfxHandles.size() - 1;
+	}
+
+	return -1;
+}
+
+int oamlBase::GetLayerHandle(const char *layer) {
+	ASSERT(layer != NULL);
+
+	// Layers are never removed, their id is as good as a handle
+	return GetLayerId(layer);
+}
+
+oamlTrack* oamlBase::GetTrackByHandle(int handle) {
+	if (handle < 0 || handle >= (int)trackHandles.size())
+		return NULL;
+
+	return trackHandles[handle];
+}
+
+void oamlBase::ReleaseHandles(oamlTrack *track, oamlAudio *audio) {
+	// Keep the slots so the other handles don't move, using a released one fails like an unknown name
+	for (size_t i=0; i<trackHandles.size(); i++) {
+		if (track && trackHandles[i] == track) {
+			trackHandles[i] = NULL;
+		}
+	}
+
+	for (size_t i=0; i<sfxHandles.size(); i++) {
+		if ((track && sfxHandles[i].first == track) || (audio && sfxHandles[i].second == audio)) {
+			sfxHandles[i].first = NULL;
+			sfxHandles[i].second = NULL;
+		}
+	}
+}
+
+oamlRC oamlBase::PlayTrackHandle(int handle) {
+	oamlTrack *track = GetTrackByHandle(handle);
+	if (track == NULL || track->IsMusicTrack() == false)
+		return OAML_ERROR;
+
+	return QueuePlayTrack(track);
+}
+
+oamlRC oamlBase::PlaySfxHandle(int handle, float vol, float pan) {
+	if (handle < 0 || handle >= (int)sfxHandles.size() || sfxHandles[handle].second == NULL)
+		return OAML_ERROR;
+
+	return QueuePlaySfx(sfxHandles[handle].first, sfxHandles[handle].second, vol, pan);
+}
+
+oamlRC oamlBase::LoadTrackHandle(int handle) {
+	oamlTrack *track = GetTrackByHandle(handle);
+	if (track == NULL)
+		return OAML_ERROR;
+
+	return LoadTrackFiles(track);
+}
+
+bool oamlBase::IsTrackPlayingHandle(int handle) {
+	oamlTrack *track = GetTrackByHandle(handle);
+	if (track == NULL || track->IsMusicTrack() == false)
+		return false;
+
+	return track->IsPlaying();
+}
+
+void oamlBase::SetLayerGainHandle(int handle, float gain) {
+	if (handle < 0 || handle >= (int)layers.size())
+		return;
+
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_SET_LAYER_GAIN;
+	cmd.layer = layers[handle];
+	cmd.vol = gain;
+	commands.Push(cmd);
+}
+
 oamlRC oamlBase::PlayTrackWithStringRandom(const char *str) {
 	std::vector<int> list;
 
@@ -484,7 +881,7 @@ oamlRC oamlBase::PlayTrackByGroupRandom(const char *group) {
 	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, group);
 
 	for (size_t i=0; i<musicTracks.size(); i++) {
-		if (musicTracks[i]->HasGroup(std::string(group))) {
+		if (musicTracks[i]->HasGroup(group)) {
 			list.push_back(i);
 		}
 	}
@@ -506,7 +903,7 @@ oamlRC oamlBase::PlayTrackByGroupAndSubgroupRandom(const char *group, const char
 	if (verbose) __oamlLog("%s %s %s\n", __FUNCTION__, group, subgroup);
 
 	for (size_t i=0; i<musicTracks.size(); i++) {
-		if (musicTracks[i]->HasGroup(std::string(group)) && musicTracks[i]->HasSubgroup(std::string(subgroup))) {
+		if (musicTracks[i]->HasGroup(group) && musicTracks[i]->HasSubgroup(subgroup)) {
 			list.push_back(i);
 		}
 	}
@@ -524,48 +921,123 @@ oamlRC oamlBase::LoadTrack(const char *name) {
 
 	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, name);
 
-	for (std::vector<oamlTrack*>::iterator it=musicTracks.begin(); it<musicTracks.end(); ++it) {
-		oamlTrack *track = *it;
-		if (track->GetName().compare(name) == 0) {
-			return track->Load();
-		}
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL)
+		return OAML_ERROR;
+
+	return LoadTrackFiles(track);
+}
+
+oamlRC oamlBase::LoadTrackFiles(oamlTrack *track) {
+	// Every file of the track is decoded in parallel, this thread helps out and waits for the rest
+	std::vector<oamlAudioFile*> list;
+	track->GetAudioFiles(list);
+
+	// Files trim the cache as they finish, so don't let them evict each other before we're done
+	for (std::vector<oamlAudioFile*>::iterator it=list.begin(); it<list.end(); ++it) {
+		(*it)->HoldSample();
 	}
 
-	return OAML_ERROR;
+	oamlRC rc = loader.Load(list);
+
+	for (std::vector<oamlAudioFile*>::iterator it=list.begin(); it<list.end(); ++it) {
+		(*it)->ReleaseSample();
+	}
+	samples.Trim();
+
+	return rc;
 }
 
-float oamlBase::LoadTrackProgress(const char *name) {
+oamlRC oamlBase::LoadTrackAsync(const char *name) {
 	ASSERT(name != NULL);
 
 	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, name);
 
-	for (std::vector<oamlTrack*>::iterator it=musicTracks.begin(); it<musicTracks.end(); ++it) {
-		oamlTrack *track = *it;
-		if (track->GetName().compare(name) == 0) {
-			return track->LoadProgress();
-		}
-	}
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL)
+		return OAML_NOT_FOUND;
 
-	return -1.f;
+	std::vector<oamlAudioFile*> list;
+	track->GetAudioFiles(list);
+	loader.Queue(list);
+
+	return OAML_OK;
 }
 
-bool oamlBase::IsTrackPlaying(const char *name) {
+float oamlBase::LoadTrackProgress(const char *name) {
 	ASSERT(name != NULL);
 
-	for (size_t i=0; i<musicTracks.size(); i++) {
-		if (musicTracks[i]->GetName().compare(name) == 0) {
-			return IsTrackPlayingId(i);
-		}
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL)
+		return -1.f;
+
+	// Make sure the files are being loaded, this is a no-op if they're already queued or loaded
+	std::vector<oamlAudioFile*> list;
+	track->GetAudioFiles(list);
+	loader.Queue(list);
+
+	return track->LoadProgress();
+}
+
+void oamlBase::SetLoaderThreads(int count) {
+	loader.SetThreads(count);
+}
+
+oamlRC oamlBase::SetTrackPinned(const char *name, bool pin) {
+	ASSERT(name != NULL);
+
+	if (verbose) __oamlLog("%s %s %d\n", __FUNCTION__, name, pin);
+
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL)
+		return OAML_NOT_FOUND;
+
+	std::vector<oamlAudioFile*> list;
+	track->GetAudioFiles(list);
+	for (std::vector<oamlAudioFile*>::iterator it=list.begin(); it<list.end(); ++it) {
+		(*it)->SetPinned(pin);
 	}
 
-	return false;
+	if (pin == false) {
+		samples.Trim();
+	}
+
+	return OAML_OK;
 }
 
-bool oamlBase::IsTrackPlayingId(int id) {
-	if (id >= (int)musicTracks.size())
+oamlRC oamlBase::PinTrack(const char *name) {
+	return SetTrackPinned(name, true);
+}
+
+oamlRC oamlBase::UnpinTrack(const char *name) {
+	return SetTrackPinned(name, false);
+}
+
+void oamlBase::SetCacheBudget(size_t bytes) {
+	samples.SetBudget(bytes);
+	samples.Trim();
+}
+
+size_t oamlBase::GetCacheMemoryUsage() {
+	return samples.GetMemoryUsage();
+}
+
+void oamlBase::SetStreamingThreshold(size_t bytes) {
+	samples.SetStreamingThreshold(bytes);
+}
+
+void oamlBase::SetCompressedPlayback(bool enable) {
+	samples.SetCompressedPlayback(enable);
+}
+
+bool oamlBase::IsTrackPlaying(const char *name) {
+	ASSERT(name != NULL);
+
+	oamlTrack *track = GetTrack(name);
+	if (track == NULL || track->IsMusicTrack() == false)
 		return false;
 
-	return musicTracks[id]->IsPlaying();
+	return track->IsPlaying();
 }
 
 bool oamlBase::IsPlaying() {
@@ -579,9 +1051,10 @@ bool oamlBase::IsPlaying() {
 
 void oamlBase::StopPlaying() {
 	if (verbose) __oamlLog("%s\n", __FUNCTION__);
-	for (size_t i=0; i<musicTracks.size(); i++) {
-		musicTracks[i]->Stop();
-	}
+
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_STOP_PLAYING;
+	commands.Push(cmd);
 }
 
 void oamlBase::Pause() {
@@ -602,34 +1075,6 @@ void oamlBase::ShowPlayingTracks() {
 	}
 }
 
-int oamlBase::SafeAdd(int sample1, int sample2) {
-	bool clipping;
-	int ret;
-
-	// Detect integer overflow and underflow, both will cause clipping in our audio
-	if (sample1 > 0 && sample2 > INT_MAX - sample1) {
-		int64_t s64a = sample1;
-		int64_t s64b = sample2;
-		ret = int(INT_MAX - ((s64a + s64b) - INT_MAX));
-		clipping = true;
-	} else if (sample1 < 0 && sample2 < INT_MIN - sample1) {
-		int64_t s64a = sample1;
-		int64_t s64b = sample2;
-		ret = int(INT_MIN - ((s64a + s64b) - INT_MIN));
-		clipping = true;
-	} else {
-		ret = sample1 + sample2;
-		clipping = false;
-	}
-
-	if (clipping && debugClipping) {
-		fprintf(stderr, "oaml: Detected clipping!\n");
-		ShowPlayingTracks();
-	}
-
-	return ret;
-}
-
 int oamlBase::ReadSample(void *buffer, int index) {
 	switch (bytesPerSample) {
 		case 1: { // 8bit (unsigned)
@@ -661,34 +1106,6 @@ int oamlBase::ReadSample(void *buffer, int index) {
 	return 0;
 }
 
-void oamlBase::WriteSample(void *buffer, int index, int sample) {
-	switch (bytesPerSample) {
-		case 1: { // 8bit (unsigned)
-			uint8_t *cbuf = (uint8_t *)buffer;
-			cbuf[index] = (uint8_t)(sample>>23); }
-			break;
-
-		case 2: { // 16bit (signed)
-			int16_t *sbuf = (int16_t *)buffer;
-			sbuf[index] = (int16_t)(sample>>16); }
-			break;
-
-		case 3: { // 24bit
-			// TODO: Test me!
-			uint8_t *cbuf = (uint8_t *)buffer;
-			cbuf[index*3+0] = (uint8_t)(sample>>8);
-			cbuf[index*3+1] = (uint8_t)(sample>>16);
-			cbuf[index*3+2] = (uint8_t)(sample>>24); }
-			break;
-
-		case 4: { // 32bit (signed)
-			int32_t *ibuf = (int32_t *)buffer;
-			ibuf[index] = (int32_t)sample; }
-			break;
-
-	}
-}
-
 bool oamlBase::IsAudioFormatSupported() {
 	// Basic check, we need a sampleRate
 	if (sampleRate == 0)
@@ -702,47 +1119,164 @@ bool oamlBase::IsAudioFormatSupported() {
 	if (bytesPerSample <= 0 || bytesPerSample > 4)
 		return false;
 
+	if (mixKernel.load() == NULL)
+		return false;
+
 	return true;
 }
 
-void oamlBase::MixToBuffer(void *buffer, int size) {
-	ASSERT(buffer != NULL);
-	ASSERT(size != 0);
+void oamlBase::MixTracks(int size, int frames, int mixChannels) {
+	if ((int)mixBuffer.size() < size) {
+		mixBuffer.resize(size);
+	}
+	memset(&mixBuffer[0], 0, size * sizeof(float));
 
-	if (IsAudioFormatSupported() == false || pause)
-		return;
+	// Let every track render the whole block at once
+	for (size_t j=0; j<sfxTracks.size(); j++) {
+		sfxTracks[j]->Mix(&mixBuffer[0], frames, mixChannels, debugClipping);
+	}
 
-	for (int i=0; i<size; i+= channels) {
-		float fsample[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for (size_t j=0; j<musicTracks.size(); j++) {
+		musicTracks[j]->Mix(&mixBuffer[0], frames, mixChannels, debugClipping);
+	}
+}
 
-		for (size_t j=0; j<sfxTracks.size(); j++) {
-			sfxTracks[j]->Mix(fsample, channels, debugClipping);
-		}
+template <int CHANNELS, bool COMPRESSOR, class OUTPUT>
+bool oamlBase::MixOutput(oamlBase *base, void *buffer, int size) {
+	// The channel count comes with the kernel, SetAudioFormat() may be changing the member meanwhile
+	int frames = size / CHANNELS;
+	base->MixTracks(size, frames, CHANNELS);
 
-		for (size_t j=0; j<musicTracks.size(); j++) {
-			musicTracks[j]->Mix(fsample, channels, debugClipping);
-		}
+	float *samples = &base->mixBuffer[0];
 
-		// Apply effects
-		if (useCompressor) {
-			compressor.ProcessData(fsample);
-		}
+	if (COMPRESSOR) {
+		base->compressor.ProcessBlock<CHANNELS>(samples, frames);
+	}
+
+	return OUTPUT()(buffer, samples, frames * CHANNELS, base->volume);
+}
 
-		for (int c=0; c<channels; c++) {
-			// Apply the volume
-			fsample[c] = fsample[c] * volume;
+template <int CHANNELS, bool COMPRESSOR>
+oamlBase::MixKernel oamlBase::GetMixKernel() {
+	if (floatBuffer)
+		return &oamlBase::MixOutput<CHANNELS, COMPRESSOR, oamlMixOutputFloat>;
 
-			if (floatBuffer) {
-				((float*)buffer)[i+c]+= fsample[c];
-			} else {
-				int sample = __oamlFloatToInteger24(fsample[c]) << 8;
+	switch (bytesPerSample) {
+		case 1: return &oamlBase::MixOutput<CHANNELS, COMPRESSOR, oamlMixOutput8>;
+		case 2: return &oamlBase::MixOutput<CHANNELS, COMPRESSOR, oamlMixOutput16>;
+		case 3: return &oamlBase::MixOutput<CHANNELS, COMPRESSOR, oamlMixOutput24>;
+		case 4: return &oamlBase::MixOutput<CHANNELS, COMPRESSOR, oamlMixOutput32>;
+	}
+
+	return NULL;
+}
+
+void oamlBase::SelectMixKernel() {
+	// Called whenever the format or the compressor changes, so MixToBuffer doesn't have to check them
+	if (channels == 1) {
+		mixKernel = useCompressor ? GetMixKernel<1, true>() : GetMixKernel<1, false>();
+	} else if (channels == 2) {
+		mixKernel = useCompressor ? GetMixKernel<2, true>() : GetMixKernel<2, false>();
+	} else {
+		mixKernel = NULL;
+	}
+}
 
-				// Mix our sample into the buffer
-				int tmp = ReadSample(buffer, i+c);
-				tmp = SafeAdd(sample, tmp);
-				WriteSample(buffer, i+c, tmp);
+void oamlBase::DropCommands(oamlTrack *track, oamlAudio *audio) {
+	// Drops the queued plays of a track that's being removed, or of every track with NULL. When only audio is
+	// being removed its sfx plays are dropped, and plays of its track stay queued minus what they hold of it.
+	// Only plays point into tracks, everything else is kept queued in the same order
+	std::vector<oamlCommand> kept;
+	oamlCommand cmd = oamlCommand();
+	while (commands.Pop(cmd)) {
+		bool ofTrack = track == NULL || cmd.track == track;
+		if (cmd.type == OAML_COMMAND_PLAY_TRACK && ofTrack) {
+			if (audio == NULL) {
+				UnprepareCommand(cmd);
+				continue;
 			}
+
+			audio->Unprepare();
+		} else if (cmd.type == OAML_COMMAND_PLAY_SFX && (audio ? cmd.audio == audio : ofTrack)) {
+			UnprepareCommand(cmd);
+			continue;
 		}
+
+		kept.push_back(cmd);
+	}
+
+	for (std::vector<oamlCommand>::iterator it=kept.begin(); it<kept.end(); ++it) {
+		commands.Push(*it);
+	}
+}
+
+void oamlBase::UnprepareCommand(oamlCommand& cmd) {
+	// Plays are queued already prepared, give back what they hold
+	if (cmd.type == OAML_COMMAND_PLAY_TRACK) {
+		cmd.track->Unprepare();
+	} else if (cmd.type == OAML_COMMAND_PLAY_SFX) {
+		cmd.audio->Unprepare();
+	}
+}
+
+void oamlBase::ProcessCommands() {
+	oamlCommand cmd;
+	while (commands.Pop(cmd)) {
+		RunCommand(cmd);
+	}
+}
+
+void oamlBase::RunCommand(oamlCommand& cmd) {
+	switch (cmd.type) {
+		case OAML_COMMAND_PLAY_TRACK:
+			if (curTrack) curTrack->Stop();
+			curTrack = cmd.track;
+			curTrack->Play();
+			break;
+
+		case OAML_COMMAND_STOP_PLAYING:
+			for (size_t i=0; i<musicTracks.size(); i++) {
+				musicTracks[i]->Stop();
+			}
+			break;
+
+		case OAML_COMMAND_PLAY_SFX:
+			cmd.track->PlayAudio(cmd.audio, cmd.vol, cmd.pan);
+			break;
+
+		case OAML_COMMAND_SET_CONDITION:
+			if (curTrack) curTrack->SetCondition(cmd.id, cmd.value);
+			break;
+
+		case OAML_COMMAND_SET_LAYER_GAIN:
+			cmd.layer->SetGain(cmd.vol);
+			break;
+
+		case OAML_COMMAND_SET_LAYER_RANDOM_CHANCE:
+			cmd.layer->SetRandomChance(cmd.value);
+			break;
+	}
+}
+
+void oamlBase::MixToBuffer(void *buffer, int size) {
+	ASSERT(buffer != NULL);
+	ASSERT(size != 0);
+
+	// Apply every API call made since the last block
+	ProcessCommands();
+
+	if (IsAudioFormatSupported() == false || pause)
+		return;
+
+	// Loaded once, the format may change while mixing this block
+	MixKernel kernel = mixKernel.load();
+	if (kernel == NULL)
+		return;
+
+	// Mix the tracks, apply effects and volume and mix our samples into the buffer
+	if (kernel(this, buffer, size) && debugClipping) {
+		fprintf(stderr, "oaml: Detected clipping!\n");
+		ShowPlayingTracks();
 	}
 
 	if (writeAudioAtShutdown) {
@@ -761,9 +1295,11 @@ void oamlBase::MixToBuffer(void *buffer, int size) {
 
 void oamlBase::SetCondition(int id, int value) {
 //	printf("%s %d %d\n", __FUNCTION__, id, value);
-	if (curTrack) {
-		curTrack->SetCondition(id, value);
-	}
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_SET_CONDITION;
+	cmd.id = id;
+	cmd.value = value;
+	commands.Push(cmd);
 }
 
 void oamlBase::SetVolume(float vol) {
@@ -792,33 +1328,36 @@ void oamlBase::SetMainLoopCondition(int value) {
 	SetCondition(OAML_CONDID_MAIN_LOOP, value);
 }
 
-void oamlBase::AddLayer(std::string layer) {
+void oamlBase::AddLayer(const std::string& layer) {
 	if (GetLayerId(layer) == -1) {
 		oamlLayer *l = new oamlLayer(layers.size(), layer);
 		layers.push_back(l);
+		layerIndex[layer] = l;
 	}
 }
 
-int oamlBase::GetLayerId(std::string layer) {
-	for (std::vector<oamlLayer*>::iterator it=layers.begin(); it<layers.end(); ++it) {
-		oamlLayer *info = *it;
-		if (info->GetName().compare(layer) == 0) {
-			return info->GetId();
-		}
-	}
+int oamlBase::GetLayerId(const std::string& layer) {
+	oamlLayer *info = GetLayer(layer);
+	if (info == NULL)
+		return -1;
 
-	return -1;
+	return info->GetId();
+}
+
+oamlLayer* oamlBase::GetLayer(const std::string& layer) {
+	std::unordered_map<std::string, oamlLayer*>::iterator it = layerIndex.find(layer);
+	if (it == layerIndex.end())
+		return NULL;
+
+	return it->second;
 }
 
-oamlLayer* oamlBase::GetLayer(std::string layer) {
+void oamlBase::IndexLayers() {
+	// The first layer wins if a rename left two with the same name
+	layerIndex.clear();
 	for (std::vector<oamlLayer*>::iterator it=layers.begin(); it<layers.end(); ++it) {
-		oamlLayer *info = *it;
-		if (info->GetName().compare(layer) == 0) {
-			return info;
-		}
+		layerIndex.insert(std::make_pair((*it)->GetName(), *it));
 	}
-
-	return NULL;
 }
 
 void oamlBase::SetLayerGain(const char *layer, float gain) {
@@ -826,7 +1365,11 @@ void oamlBase::SetLayerGain(const char *layer, float gain) {
 	if (info == NULL)
 		return;
 
-	info->SetGain(gain);
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_SET_LAYER_GAIN;
+	cmd.layer = info;
+	cmd.vol = gain;
+	commands.Push(cmd);
 }
 
 void oamlBase::SetLayerRandomChance(const char *layer, int randomChance) {
@@ -834,7 +1377,11 @@ void oamlBase::SetLayerRandomChance(const char *layer, int randomChance) {
 	if (info == NULL)
 		return;
 
-	info->SetRandomChance(randomChance);
+	oamlCommand cmd = oamlCommand();
+	cmd.type = OAML_COMMAND_SET_LAYER_RANDOM_CHANCE;
+	cmd.layer = info;
+	cmd.value = randomChance;
+	commands.Push(cmd);
 }
 
 void oamlBase::UpdateTension(uint64_t ms) {
@@ -875,10 +1422,26 @@ void oamlBase::Update() {
 
 		timeMs = ms;
 	}
+
+	// Evict decoded audio that isn't playing if we're over the memory budget
+	samples.Trim();
 }
 
 void oamlBase::SetFileCallbacks(oamlFileCallbacks *cbs) {
-	fcbs = cbs;
+	// Old style callbacks have none of the optional hooks
+	memset(&userCbs, 0, sizeof(userCbs));
+	userCbs.open = cbs->open;
+	userCbs.read = cbs->read;
+	userCbs.seek = cbs->seek;
+	userCbs.tell = cbs->tell;
+	userCbs.close = cbs->close;
+
+	fcbs = &userCbs;
+}
+
+void oamlBase::SetFileCallbacks(oamlFileCallbacks2 *cbs) {
+	userCbs = *cbs;
+	fcbs = &userCbs;
 }
 
 void oamlBase::EnableDynamicCompressor(bool enable, double threshold, double ratio) {
@@ -886,7 +1449,13 @@ void oamlBase::EnableDynamicCompressor(bool enable, double threshold, double rat
 	if (useCompressor) {
 		compressor.SetThreshold(threshold);
 		compressor.SetRatio(ratio);
+
+		if (sampleRate > 0) {
+			compressor.SetAudioFormat(channels, sampleRate);
+		}
 	}
+
+	SelectMixKernel();
 }
 
 oamlTracksInfo* oamlBase::GetTracksInfo() {
@@ -934,6 +1503,9 @@ const char* oamlBase::GetPlayingInfo() {
 }
 
 void oamlBase::Clear() {
+	loader.Flush();
+	DropCommands(NULL, NULL);
+
 	while (musicTracks.empty() == false) {
 		oamlTrack *track = musicTracks.back();
 		musicTracks.pop_back();
@@ -953,6 +1525,10 @@ void oamlBase::Clear() {
 	}
 	tracksInfo.tracks.clear();
 
+	trackHandles.clear();
+	sfxHandles.clear();
+	trackIndex.clear();
+
 	curTrack = NULL;
 }
 
@@ -1012,33 +1588,48 @@ oamlRC oamlBase::TrackNew(std::string name, bool sfxTrack) {
 	} else {
 		sfxTracks.push_back(track);
 	}
+	IndexTrack(track);
 
 	return OAML_OK;
 }
 
-oamlTrack* oamlBase::GetTrack(std::string name) {
+void oamlBase::IndexTrack(oamlTrack *track) {
+	// Music tracks are found first when an sfx track has the same name, otherwise the first one added wins
+	std::pair<std::unordered_map<std::string, oamlTrack*>::iterator, bool> ret = trackIndex.insert(std::make_pair(track->GetName(), track));
+	if (ret.second == false && track->IsMusicTrack() && ret.first->second->IsMusicTrack() == false) {
+		ret.first->second = track;
+	}
+}
+
+void oamlBase::IndexTracks() {
+	trackIndex.clear();
 	for (std::vector<oamlTrack*>::iterator it=musicTracks.begin(); it<musicTracks.end(); ++it) {
-		oamlTrack *track = *it;
-		if (track->GetName().compare(name) == 0) {
-			return track;
-		}
+		IndexTrack(*it);
 	}
 
 	for (std::vector<oamlTrack*>::iterator it=sfxTracks.begin(); it<sfxTracks.end(); ++it) {
-		oamlTrack *track = *it;
-		if (track->GetName().compare(name) == 0) {
-			return track;
-		}
+		IndexTrack(*it);
 	}
+}
 
-	return NULL;
+oamlTrack* oamlBase::GetTrack(const std::string& name) {
+	std::unordered_map<std::string, oamlTrack*>::iterator it = trackIndex.find(name);
+	if (it == trackIndex.end())
+		return NULL;
+
+	return it->second;
 }
 
 oamlRC oamlBase::TrackRemove(std::string name) {
+	loader.Flush();
+
 	for (std::vector<oamlTrack*>::iterator it=musicTracks.begin(); it<musicTracks.end(); ++it) {
 		oamlTrack *track = *it;
 		if (track->GetName().compare(name) == 0) {
+			DropCommands(track, NULL);
 			musicTracks.erase(it);
+			ReleaseHandles(track, NULL);
+			IndexTracks();
 			delete track;
 			return OAML_OK;
 		}
@@ -1047,7 +1638,10 @@ oamlRC oamlBase::TrackRemove(std::string name) {
 	for (std::vector<oamlTrack*>::iterator it=sfxTracks.begin(); it<sfxTracks.end(); ++it) {
 		oamlTrack *track = *it;
 		if (track->GetName().compare(name) == 0) {
+			DropCommands(track, NULL);
 			sfxTracks.erase(it);
+			ReleaseHandles(track, NULL);
+			IndexTracks();
 			delete track;
 			return OAML_OK;
 		}
@@ -1062,6 +1656,7 @@ void oamlBase::TrackRename(std::string name, std::string newName) {
 		return;
 
 	track->SetName(newName);
+	IndexTracks();
 }
 
 void oamlBase::TrackSetVolume(std::string name, float volume) {
@@ -1178,7 +1773,7 @@ oamlRC oamlBase::AudioNew(std::string trackName, std::string audioName, int type
 	if (track == NULL)
 		return OAML_NOT_FOUND;
 
-	oamlAudio *audio = new oamlAudio(fcbs, verbose);
+	oamlAudio *audio = new oamlAudio(fcbs, &samples, verbose);
 	if (audio == NULL)
 		return OAML_ERROR;
 
@@ -1187,11 +1782,12 @@ oamlRC oamlBase::AudioNew(std::string trackName, std::string audioName, int type
 	audio->SetBPM(bpm);
 	audio->SetBeatsPerBar(beatsPerBar);
 	track->AddAudio(audio);
+	track->InvalidateConditions();
 
 	return OAML_OK;
 }
 
-oamlAudio* oamlBase::GetAudio(std::string trackName, std::string audioName) {
+oamlAudio* oamlBase::GetAudio(const std::string& trackName, const std::string& audioName) {
 	oamlTrack *track = GetTrack(trackName);
 	if (track == NULL)
 		return NULL;
@@ -1204,7 +1800,17 @@ oamlRC oamlBase::AudioRemove(std::string trackName, std::string audioName) {
 	if (track == NULL)
 		return OAML_NOT_FOUND;
 
-	return track->RemoveAudio(audioName);
+	// Queued plays of the track hold the audio prepared
+	loader.Flush();
+	oamlAudio *audio = track->GetAudio(audioName);
+	if (audio) {
+		DropCommands(track, audio);
+	}
+	ReleaseHandles(NULL, audio);
+	oamlRC rc = track->RemoveAudio(audioName);
+	track->InvalidateConditions();
+
+	return rc;
 }
 
 void oamlBase::AudioAddAudioFile(std::string trackName, std::string audioName, std::string filename) {
@@ -1216,11 +1822,16 @@ void oamlBase::AudioAddAudioFile(std::string trackName, std::string audioName, s
 }
 
 void oamlBase::AudioSetName(std::string trackName, std::string audioName, std::string name) {
-	oamlAudio *audio = GetAudio(trackName, audioName);
+	oamlTrack *track = GetTrack(trackName);
+	if (track == NULL)
+		return;
+
+	oamlAudio *audio = track->GetAudio(audioName);
 	if (audio == NULL)
 		return;
 
 	audio->SetName(name);
+	track->ReindexAudios();
 }
 
 void oamlBase::AudioSetVolume(std::string trackName, std::string audioName, float volume) {
@@ -1309,6 +1920,9 @@ void oamlBase::AudioSetCondId(std::string trackName, std::string audioName, int
 		return;
 
 	audio->SetCondId(condId);
+
+	// Conditions are dispatched through an index built from these
+	GetTrack(trackName)->InvalidateConditions();
 }
 
 void oamlBase::AudioSetCondType(std::string trackName, std::string audioName, int condType) {
@@ -1317,6 +1931,7 @@ void oamlBase::AudioSetCondType(std::string trackName, std::string audioName, in
 		return;
 
 	audio->SetCondType(condType);
+	GetTrack(trackName)->InvalidateConditions();
 }
 
 void oamlBase::AudioSetCondValue(std::string trackName, std::string audioName, int condValue) {
@@ -1325,6 +1940,7 @@ void oamlBase::AudioSetCondValue(std::string trackName, std::string audioName, i
 		return;
 
 	audio->SetCondValue(condValue);
+	GetTrack(trackName)->InvalidateConditions();
 }
 
 void oamlBase::AudioSetCondValue2(std::string trackName, std::string audioName, int condValue2) {
@@ -1333,6 +1949,7 @@ void oamlBase::AudioSetCondValue2(std::string trackName, std::string audioName,
 		return;
 
 	audio->SetCondValue2(condValue2);
+	GetTrack(trackName)->InvalidateConditions();
 }
 
 bool oamlBase::AudioExists(std::string trackName, std::string audioName) {
@@ -1468,7 +2085,7 @@ int oamlBase::AudioGetCondValue2(std::string trackName, std::string audioName) {
 	return audio->GetCondValue2();
 }
 
-oamlAudioFile* oamlBase::GetAudioFile(std::string trackName, std::string audioName, std::string filename) {
+oamlAudioFile* oamlBase::GetAudioFile(const std::string& trackName, const std::string& audioName, const std::string& filename) {
 	oamlAudio *audio = GetAudio(trackName, audioName);
 	if (audio == NULL)
 		return NULL;
@@ -1481,6 +2098,8 @@ void oamlBase::AudioFileRemove(std::string trackName, std::string audioName, std
 	if (audio == NULL)
 		return;
 
+	// Queued plays can stay, the file gives back what they hold of it when it's deleted
+	loader.Flush();
 	audio->RemoveAudioFile(filename);
 }
 
@@ -1535,6 +2154,7 @@ void oamlBase::LayerRename(std::string layerName, std::string name) {
 		return;
 
 	layer->SetName(name);
+	IndexLayers();
 }
 
 int oamlBase::LayerGetId(std::string layerName) {
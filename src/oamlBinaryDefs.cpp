@@ -0,0 +1,179 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlBinaryDefs::oamlBinaryDefs() {
+	buf = NULL;
+	size = 0;
+	pos = 0;
+	error = false;
+}
+
+oamlBinaryDefs::~oamlBinaryDefs() {
+}
+
+bool oamlBinaryDefs::IsBinaryDefs(const char *buffer, size_t bufferSize) {
+	return bufferSize >= 4 && memcmp(buffer, OAML_BINARY_DEFS_MAGIC, 4) == 0;
+}
+
+void oamlBinaryDefs::PutUInt(ByteBuffer& out, uint32_t value) {
+	out.put(uint8_t(value));
+	out.put(uint8_t(value >> 8));
+	out.put(uint8_t(value >> 16));
+	out.put(uint8_t(value >> 24));
+}
+
+void oamlBinaryDefs::PutInt(int value) {
+	PutUInt(data, (uint32_t)value);
+}
+
+void oamlBinaryDefs::PutFloat(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	PutUInt(data, bits);
+}
+
+void oamlBinaryDefs::PutString(const std::string& str) {
+	std::map<std::string, uint32_t>::iterator it = stringIds.find(str);
+	if (it != stringIds.end()) {
+		PutUInt(data, it->second);
+		return;
+	}
+
+	uint32_t id = (uint32_t)strings.size();
+	strings.push_back(str);
+	stringIds[str] = id;
+	PutUInt(data, id);
+}
+
+oamlRC oamlBinaryDefs::Save(const char *filename) {
+	ByteBuffer out;
+
+	out.putBytes((uint8_t*)OAML_BINARY_DEFS_MAGIC, 4);
+	PutUInt(out, OAML_BINARY_DEFS_VERSION);
+
+	PutUInt(out, (uint32_t)strings.size());
+	for (std::vector<std::string>::iterator it=strings.begin(); it<strings.end(); ++it) {
+		PutUInt(out, (uint32_t)it->size());
+		out.putBytes((uint8_t*)it->data(), (uint32_t)it->size());
+	}
+
+	out.put(&data);
+
+	FILE *f = fopen(filename, "wb");
+	if (f == NULL) {
+		fprintf(stderr, "liboaml: Error creating '%s'\n", filename);
+		return OAML_ERROR;
+	}
+
+	size_t bytes = fwrite(out.getRawData(), 1, out.size(), f);
+	fclose(f);
+
+	if (bytes != out.size()) {
+		fprintf(stderr, "liboaml: Error writing '%s'\n", filename);
+		return OAML_ERROR;
+	}
+
+	return OAML_OK;
+}
+
+const uint8_t *oamlBinaryDefs::Fetch(size_t bytes) {
+	if (error || bytes > size - pos) {
+		error = true;
+		return NULL;
+	}
+
+	const uint8_t *ptr = buf + pos;
+	pos+= bytes;
+	return ptr;
+}
+
+oamlRC oamlBinaryDefs::Open(const char *buffer, size_t bufferSize) {
+	buf = (const uint8_t*)buffer;
+	size = bufferSize;
+	pos = 0;
+	error = false;
+	stringOffsets.clear();
+
+	if (IsBinaryDefs(buffer, bufferSize) == false) {
+		return OAML_ERROR;
+	}
+	pos = 4;
+
+	int version = GetInt();
+	if (version != OAML_BINARY_DEFS_VERSION) {
+		fprintf(stderr, "liboaml: Unsupported compiled definitions version %d\n", version);
+		return OAML_ERROR;
+	}
+
+	// Strings are left in the buffer, we only remember where each one starts
+	unsigned int count = (unsigned int)GetInt();
+	if (error || count > size / 4) {
+		error = true;
+		return OAML_ERROR;
+	}
+
+	stringOffsets.reserve(count);
+	for (unsigned int i=0; i<count; i++) {
+		size_t offset = pos;
+		unsigned int len = (unsigned int)GetInt();
+		if (Fetch(len) == NULL)
+			return OAML_ERROR;
+
+		stringOffsets.push_back(offset);
+	}
+
+	return error ? OAML_ERROR : OAML_OK;
+}
+
+int oamlBinaryDefs::GetInt() {
+	const uint8_t *ptr = Fetch(4);
+	if (ptr == NULL)
+		return 0;
+
+	return (int)(uint32_t(ptr[0]) | (uint32_t(ptr[1]) << 8) | (uint32_t(ptr[2]) << 16) | (uint32_t(ptr[3]) << 24));
+}
+
+float oamlBinaryDefs::GetFloat() {
+	uint32_t bits = (uint32_t)GetInt();
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+std::string oamlBinaryDefs::GetString() {
+	unsigned int id = (unsigned int)GetInt();
+	if (error || id >= stringOffsets.size()) {
+		error = true;
+		return "";
+	}
+
+	const uint8_t *ptr = buf + stringOffsets[id];
+	size_t len = size_t(ptr[0]) | (size_t(ptr[1]) << 8) | (size_t(ptr[2]) << 16) | (size_t(ptr[3]) << 24);
+	return std::string((const char*)ptr + 4, len);
+}
@@ -50,6 +50,10 @@ oamlRC oamlInitString(const char *defs) {
 	return oaml.InitString(defs);
 }
 
+oamlRC oamlCompileDefs(const char *defsFilename, const char *outFilename) {
+	return oaml.CompileDefs(defsFilename, outFilename);
+}
+
 void oamlSetAudioFormat(int sampleRate, int channels, int bytesPerSample, bool floatBuffer) {
 	oaml.SetAudioFormat(sampleRate, channels, bytesPerSample, floatBuffer);
 }
@@ -74,6 +78,78 @@ oamlRC oamlPlaySfx2d(const char *name, int x, int y, int width, int height) {
 	return oaml.PlaySfx2d(name, x, y, width, height);
 }
 
+int oamlGetTrackHandle(const char *name) {
+	return oaml.GetTrackHandle(name);
+}
+
+int oamlGetSfxHandle(const char *name) {
+	return oaml.GetSfxHandle(name);
+}
+
+int oamlGetLayerHandle(const char *layer) {
+	return oaml.GetLayerHandle(layer);
+}
+
+oamlRC oamlPlayTrackHandle(int handle) {
+	return oaml.PlayTrackHandle(handle);
+}
+
+oamlRC oamlPlaySfxHandle(int handle) {
+	return oaml.PlaySfxHandle(handle, 1.f, 0.f);
+}
+
+oamlRC oamlPlaySfxExHandle(int handle, float vol, float pan) {
+	return oaml.PlaySfxHandle(handle, vol, pan);
+}
+
+oamlRC oamlLoadTrackHandle(int handle) {
+	return oaml.LoadTrackHandle(handle);
+}
+
+bool oamlIsTrackPlayingHandle(int handle) {
+	return oaml.IsTrackPlayingHandle(handle);
+}
+
+void oamlSetLayerGainHandle(int handle, float gain) {
+	oaml.SetLayerGainHandle(handle, gain);
+}
+
+oamlRC oamlLoadTrackAsync(const char *name) {
+	return oaml.LoadTrackAsync(name);
+}
+
+float oamlLoadTrackProgress(const char *name) {
+	return oaml.LoadTrackProgress(name);
+}
+
+void oamlSetLoaderThreads(int count) {
+	oaml.SetLoaderThreads(count);
+}
+
+oamlRC oamlPinTrack(const char *name) {
+	return oaml.PinTrack(name);
+}
+
+oamlRC oamlUnpinTrack(const char *name) {
+	return oaml.UnpinTrack(name);
+}
+
+void oamlSetCacheBudget(size_t bytes) {
+	oaml.SetCacheBudget(bytes);
+}
+
+size_t oamlGetCacheMemoryUsage() {
+	return oaml.GetCacheMemoryUsage();
+}
+
+void oamlSetStreamingThreshold(size_t bytes) {
+	oaml.SetStreamingThreshold(bytes);
+}
+
+void oamlSetCompressedPlayback(bool enable) {
+	oaml.SetCompressedPlayback(enable);
+}
+
 bool oamlIsTrackPlaying(const char *name) {
 	return oaml.IsTrackPlaying(name);
 }
@@ -142,6 +218,10 @@ void oamlSetFileCallbacks(oamlFileCallbacks *cbs) {
 	oaml.SetFileCallbacks(cbs);
 }
 
+void oamlSetFileCallbacks2(oamlFileCallbacks2 *cbs) {
+	oaml.SetFileCallbacks(cbs);
+}
+
 void oamlEnableDynamicCompressor(bool enable, double threshold, double ratio) {
 	oaml.EnableDynamicCompressor(enable, threshold, ratio);
 }
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlCommandQueue::oamlCommandQueue(size_t size) {
+	ASSERT((size & (size - 1)) == 0);
+
+	cells = new Cell[size];
+	mask = size - 1;
+
+	for (size_t i=0; i<size; i++) {
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	enqueuePos.store(0, std::memory_order_relaxed);
+	dequeuePos.store(0, std::memory_order_relaxed);
+
+	overflowPos = 0;
+	overflowed = false;
+}
+
+oamlCommandQueue::~oamlCommandQueue() {
+	delete[] cells;
+}
+
+bool oamlCommandQueue::PushRing(const oamlCommand& cmd) {
+	Cell *cell;
+	size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+	for (;;) {
+		cell = &cells[pos & mask];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			// Cell is free, try to claim it
+			if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// Queue is full
+			return false;
+		} else {
+			// Another producer got here first
+			pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->cmd = cmd;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+bool oamlCommandQueue::PopRing(oamlCommand& cmd) {
+	Cell *cell;
+	size_t pos = dequeuePos.load(std::memory_order_relaxed);
+
+	for (;;) {
+		cell = &cells[pos & mask];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (diff == 0) {
+			if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			// Queue is empty
+			return false;
+		} else {
+			pos = dequeuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cmd = cell->cmd;
+	cell->sequence.store(pos + mask + 1, std::memory_order_release);
+
+	return true;
+}
+
+void oamlCommandQueue::Push(const oamlCommand& cmd) {
+	if (overflowed == false && PushRing(cmd))
+		return;
+
+	// The mixer isn't keeping up or isn't running yet, keep it for later instead of losing it
+	std::lock_guard<std::mutex> guard(overflowMutex);
+	overflow.push_back(cmd);
+	overflowed = true;
+}
+
+bool oamlCommandQueue::Pop(oamlCommand& cmd) {
+	// Everything in the ring is older than what's in the overflow
+	if (PopRing(cmd))
+		return true;
+
+	if (overflowed == false)
+		return false;
+
+	std::lock_guard<std::mutex> guard(overflowMutex);
+	if (overflowPos >= overflow.size())
+		return false;
+
+	cmd = overflow[overflowPos++];
+	if (overflowPos == overflow.size()) {
+		// Keeps the capacity, the ring is used again from here on
+		overflow.clear();
+		overflowPos = 0;
+		overflowed = false;
+	}
+
+	return true;
+}
+
+void oamlCommandQueue::Clear() {
+	oamlCommand cmd;
+	while (Pop(cmd)) {
+	}
+}
@@ -59,27 +59,9 @@ void oamlCompressor::SetAudioFormat(int channels, int sampleRate) {
 }
 
 void oamlCompressor::ProcessData(float *data) {
-	float peak = 0;
-	for (int i=0; i<chnum; i++) {
-		float val = fabs(data[i]);
-		if (val > peak) peak = val;
-	}
-
-	if (peak > env) {
-		env = att * (env - peak) + peak;
+	if (chnum == 1) {
+		ProcessFrame<1>(data);
 	} else {
-		env = rel * (env - peak) + peak;
-	}
-
-	float gain;
-	if (env > threshold) {
-		gain = float(threshold / (1.0 + ratio * ((env / threshold) - 1.0)));
-	} else {
-		gain = float(threshold);
-	}
-
-	gain = gain * 0.5f + 0.5f;
-	for (int i=0; i<chnum; i++) {
-		data[i]*= gain;
+		ProcessFrame<2>(data);
 	}
 }
@@ -0,0 +1,197 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlLoader::oamlLoader() {
+	verbose = false;
+	quit = false;
+	running = 0;
+
+	threadsCount = (int)std::thread::hardware_concurrency();
+	if (threadsCount < 1) threadsCount = 1;
+	if (threadsCount > 4) threadsCount = 4;
+}
+
+oamlLoader::~oamlLoader() {
+	StopThreads();
+}
+
+void oamlLoader::SetThreads(int count) {
+	if (count < 1) count = 1;
+
+	StopThreads();
+
+	// Anything still queued is picked up by the new threads
+	std::lock_guard<std::mutex> guard(mutex);
+	threadsCount = count;
+	if (jobs.empty() == false) {
+		StartThreads();
+	}
+}
+
+void oamlLoader::StartThreads() {
+	// Called with the mutex held
+	if (threads.empty() == false)
+		return;
+
+	if (verbose) __oamlLog("%s %d\n", __FUNCTION__, threadsCount);
+
+	quit = false;
+	for (int i=0; i<threadsCount; i++) {
+		threads.push_back(std::thread(&oamlLoader::WorkerThread, this));
+	}
+}
+
+void oamlLoader::StopThreads() {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		if (threads.empty())
+			return;
+
+		// Only the workers go away, queued jobs stay until they're run or flushed
+		quit = true;
+	}
+
+	jobAvailable.notify_all();
+	for (std::vector<std::thread>::iterator it=threads.begin(); it<threads.end(); ++it) {
+		it->join();
+	}
+	threads.clear();
+
+	std::lock_guard<std::mutex> guard(mutex);
+	quit = false;
+}
+
+void oamlLoader::WorkerThread() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for (;;) {
+		while (quit == false && jobs.empty())
+			jobAvailable.wait(lock);
+
+		if (quit)
+			break;
+
+		oamlAudioFile *file = jobs.front();
+		jobs.pop_front();
+		Run(file, lock);
+	}
+}
+
+void oamlLoader::Run(oamlAudioFile *file, std::unique_lock<std::mutex>& lock) {
+	// Called with the mutex held, it's released while the file loads
+	running++;
+
+	lock.unlock();
+	if (file->Load() != OAML_OK) {
+		fprintf(stderr, "liboaml: Error loading: '%s'\n", file->GetFilenameStr());
+	}
+	lock.lock();
+
+	pending.erase(file);
+	running--;
+	jobDone.notify_all();
+}
+
+void oamlLoader::Queue(oamlAudioFile *file) {
+	if (file->IsLoaded())
+		return;
+
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+
+		// Already queued or being loaded
+		if (pending.find(file) != pending.end())
+			return;
+
+		StartThreads();
+
+		pending.insert(file);
+		jobs.push_back(file);
+	}
+
+	jobAvailable.notify_one();
+}
+
+void oamlLoader::Queue(std::vector<oamlAudioFile*>& files) {
+	for (std::vector<oamlAudioFile*>::iterator it=files.begin(); it<files.end(); ++it) {
+		Queue(*it);
+	}
+}
+
+oamlRC oamlLoader::Load(std::vector<oamlAudioFile*>& files) {
+	Queue(files);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;) {
+		// Rather than just wait, take any of our files the threads haven't started on yet
+		bool waiting = false;
+		oamlAudioFile *file = NULL;
+		for (std::vector<oamlAudioFile*>::iterator it=files.begin(); it<files.end() && file == NULL; ++it) {
+			if (pending.find(*it) == pending.end())
+				continue;
+
+			waiting = true;
+			std::deque<oamlAudioFile*>::iterator job = std::find(jobs.begin(), jobs.end(), *it);
+			if (job != jobs.end()) {
+				file = *job;
+				jobs.erase(job);
+			}
+		}
+
+		if (waiting == false)
+			break;
+
+		if (file) {
+			Run(file, lock);
+		} else {
+			jobDone.wait(lock);
+		}
+	}
+	lock.unlock();
+
+	// A flush may have dropped some of them before they ran, only what's decoded counts
+	for (std::vector<oamlAudioFile*>::iterator it=files.begin(); it<files.end(); ++it) {
+		if ((*it)->IsLoaded() == false || (*it)->LoadProgress() < 0.f)
+			return OAML_ERROR;
+	}
+
+	return OAML_OK;
+}
+
+void oamlLoader::Flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	for (std::deque<oamlAudioFile*>::iterator it=jobs.begin(); it<jobs.end(); ++it) {
+		pending.erase(*it);
+	}
+	jobs.clear();
+
+	while (running > 0)
+		jobDone.wait(lock);
+}
@@ -0,0 +1,129 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "oamlCommon.h"
+
+
+oamlMappedFile::oamlMappedFile() {
+	fcbs = NULL;
+	data = NULL;
+	size = 0;
+}
+
+oamlMappedFile::~oamlMappedFile() {
+	Close();
+}
+
+bool oamlMappedFile::Open(oamlFileCallbacks2 *cbs, void *fd) {
+	Close();
+
+	if (cbs->map == NULL || fd == NULL)
+		return false;
+
+	size_t mapSize = 0;
+	const void *ptr = cbs->map(fd, &mapSize);
+	if (ptr == NULL)
+		return false;
+
+	fcbs = cbs;
+	data = (const uint8_t*)ptr;
+	size = mapSize;
+	return true;
+}
+
+void oamlMappedFile::Close() {
+	if (data && fcbs->unmap) {
+		fcbs->unmap(data, size);
+	}
+
+	fcbs = NULL;
+	data = NULL;
+	size = 0;
+}
+
+#ifdef _WIN32
+
+const void* oamlMappedFile::MapStdioFile(void *fd, size_t *size) {
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno((FILE*)fd));
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	LARGE_INTEGER fileSize;
+	if (GetFileSizeEx(file, &fileSize) == 0 || fileSize.QuadPart == 0)
+		return NULL;
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+		return NULL;
+
+	// The view keeps the mapping alive on its own
+	const void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (ptr == NULL)
+		return NULL;
+
+	*size = (size_t)fileSize.QuadPart;
+	return ptr;
+}
+
+void oamlMappedFile::UnmapStdioFile(const void *ptr, size_t) {
+	UnmapViewOfFile(ptr);
+}
+
+#else
+
+const void* oamlMappedFile::MapStdioFile(void *fd, size_t *size) {
+	int file = fileno((FILE*)fd);
+	if (file == -1)
+		return NULL;
+
+	struct stat st;
+	if (fstat(file, &st) == -1 || st.st_size == 0)
+		return NULL;
+
+	// The mapping stays valid after the file is closed
+	void *ptr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, file, 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	*size = (size_t)st.st_size;
+	return ptr;
+}
+
+void oamlMappedFile::UnmapStdioFile(const void *ptr, size_t size) {
+	munmap((void*)ptr, size);
+}
+
+#endif
@@ -0,0 +1,101 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlMemoryFile::oamlMemoryFile() : refs(1) {
+	mapped = NULL;
+	data = NULL;
+	size = 0;
+}
+
+oamlMemoryFile::~oamlMemoryFile() {
+	if (mapped) {
+		delete mapped;
+		mapped = NULL;
+	}
+}
+
+bool oamlMemoryFile::Load(const char *filename, oamlFileCallbacks2 *cbs) {
+	void *fd = cbs->open(filename);
+	if (fd == NULL)
+		return false;
+
+	// Already in memory if the file can be mapped
+	mapped = new oamlMappedFile();
+	if (mapped->Open(cbs, fd)) {
+		cbs->close(fd);
+
+		data = mapped->GetData();
+		size = mapped->GetSize();
+		return true;
+	}
+
+	delete mapped;
+	mapped = NULL;
+
+	long fileSize = cbs->size ? cbs->size(fd) : -1;
+	if (fileSize < 0 && cbs->seek(fd, 0, SEEK_END) == 0) {
+		fileSize = cbs->tell(fd);
+		cbs->seek(fd, 0, SEEK_SET);
+	}
+
+	if (fileSize <= 0) {
+		cbs->close(fd);
+		return false;
+	}
+
+	buffer.resize(fileSize);
+	size_t bytes = 0;
+	while (bytes < (size_t)fileSize) {
+		size_t ret = cbs->readInto ? cbs->readInto(fd, &buffer[bytes], fileSize - bytes) : cbs->read(&buffer[bytes], 1, fileSize - bytes, fd);
+		if (ret == 0)
+			break;
+		bytes+= ret;
+	}
+	cbs->close(fd);
+
+	if (bytes == 0) {
+		buffer.clear();
+		return false;
+	}
+
+	buffer.resize(bytes);
+	data = &buffer[0];
+	size = bytes;
+	return true;
+}
+
+void oamlMemoryFile::AddRef() {
+	refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void oamlMemoryFile::Release() {
+	if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		delete this;
+	}
+}
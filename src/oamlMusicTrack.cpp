@@ -31,10 +31,12 @@ oamlMusicTrack::oamlMusicTrack(bool _verbose) {
 	verbose = _verbose;
 	name = "Track";
 	playing = false;
-	filesSamples = 0;
+	prepared = false;
 
-	playCondSamples = 0;
+	playCondPending = false;
+	playCondPos = 0;
 	playCondAudio = NULL;
+	conditionsDirty = false;
 
 	fadeIn = 0;
 	fadeOut = 0;
@@ -51,6 +53,10 @@ oamlMusicTrack::oamlMusicTrack(bool _verbose) {
 }
 
 oamlMusicTrack::~oamlMusicTrack() {
+	if (prepared) {
+		Unprepare();
+	}
+
 	ClearAudios(&introAudios);
 	ClearAudios(&loopAudios);
 	ClearAudios(&randAudios);
@@ -64,55 +70,88 @@ void oamlMusicTrack::AddAudio(oamlAudio *audio) {
 		printf("Duplicated audio name: %s\n", audio->GetName().c_str());
 	}
 
+	std::vector<oamlAudio*> *audios;
 	if (audio->GetType() == 1) {
-		introAudios.push_back(audio);
+		audios = &introAudios;
 	} else if (audio->GetType() == 4) {
-		condAudios.push_back(audio);
+		audios = &condAudios;
 	} else if (audio->GetRandomChance() > 0) {
-		randAudios.push_back(audio);
+		audios = &randAudios;
 	} else {
-		loopAudios.push_back(audio);
+		audios = &loopAudios;
 	}
+	audios->push_back(audio);
+
+	// Conditions are indexed by ReindexConditions() once the track is complete, or by the mixer after InvalidateConditions()
+	IndexAudio(audio);
 }
 
-oamlAudio* oamlMusicTrack::GetAudio(std::string filename) {
-	oamlAudio *audio;
+void oamlMusicTrack::IndexConditions(std::vector<oamlAudio*> *audios) {
+	// Mirrors where SetCondition looks: loop audios for the main loop id, condition audios for every other id
+	for (size_t i=0; i<audios->size(); i++) {
+		oamlAudio *audio = (*audios)[i];
+		if (audios == &loopAudios && audio->GetCondId() == OAML_CONDID_MAIN_LOOP) {
+			mainLoopAudios.push_back(audio);
+		} else if (audios == &condAudios && audio->GetCondId() != OAML_CONDID_MAIN_LOOP) {
+			condIndex[audio->GetCondId()].push_back(audio);
+		}
+	}
+}
 
-	audio = FindAudio(&introAudios, filename);
-	if (audio) return audio;
-	audio = FindAudio(&loopAudios, filename);
-	if (audio) return audio;
-	audio = FindAudio(&randAudios, filename);
-	if (audio) return audio;
-	audio = FindAudio(&condAudios, filename);
-	if (audio) return audio;
+oamlRC oamlMusicTrack::RemoveAudio(const std::string& audioName) {
+	if (FindAudioAndRemove(&introAudios, audioName) != OAML_OK &&
+		FindAudioAndRemove(&loopAudios, audioName) != OAML_OK &&
+		FindAudioAndRemove(&randAudios, audioName) != OAML_OK &&
+		FindAudioAndRemove(&condAudios, audioName) != OAML_OK)
+		return OAML_NOT_FOUND;
 
-	return NULL;
+	// Another audio with the same name may take its place, the caller invalidates the condition index
+	ReindexAudios();
+	return OAML_OK;
+}
+
+void oamlMusicTrack::ReindexAudios() {
+	audioIndex.clear();
+	IndexAudios(&introAudios);
+	IndexAudios(&loopAudios);
+	IndexAudios(&randAudios);
+	IndexAudios(&condAudios);
+}
+
+void oamlMusicTrack::ReindexConditions() {
+	mainLoopAudios.clear();
+	condIndex.clear();
+	IndexConditions(&loopAudios);
+	IndexConditions(&condAudios);
+
+	// Conditions may now hold for values we skipped before
+	condValues.clear();
 }
 
-oamlRC oamlMusicTrack::RemoveAudio(std::string filename) {
-	if (FindAudioAndRemove(&introAudios, filename) == OAML_OK)
-		return OAML_OK;
-	if (FindAudioAndRemove(&loopAudios, filename) == OAML_OK)
-		return OAML_OK;
-	if (FindAudioAndRemove(&randAudios, filename) == OAML_OK)
-		return OAML_OK;
-	if (FindAudioAndRemove(&condAudios, filename) == OAML_OK)
-		return OAML_OK;
-	return OAML_NOT_FOUND;
+int oamlMusicTrack::GetAudiosCount() const {
+	return int(introAudios.size() + loopAudios.size() + randAudios.size() + condAudios.size());
 }
 
 void oamlMusicTrack::SetCondition(int id, int value) {
 	bool stopCond = false;
 	bool playCond = false;
 
-	if (playCondSamples > 0)
+	if (playCondPending)
 		return;
 
+	// Audios were added, removed or had their conditions edited since the index was built
+	if (conditionsDirty.exchange(false)) {
+		ReindexConditions();
+	}
+
+	std::pair<std::unordered_map<int, int>::iterator, bool> last = condValues.insert(std::make_pair(id, value));
+	bool changed = last.second || last.first->second != value;
+	last.first->second = value;
+
 	if (id == OAML_CONDID_MAIN_LOOP) {
-		for (size_t i=0; i<loopAudios.size(); i++) {
-			oamlAudio *audio = loopAudios[i];
-			if (audio->HasCondition(id)) {
+		if (changed) {
+			for (size_t i=0; i<mainLoopAudios.size(); i++) {
+				oamlAudio *audio = mainLoopAudios[i];
 				audio->SetPickable(audio->TestCondition(id, value));
 			}
 		}
@@ -124,10 +163,16 @@ void oamlMusicTrack::SetCondition(int id, int value) {
 		return;
 	}
 
-	for (size_t i=0; i<condAudios.size(); i++) {
-		oamlAudio *audio = condAudios[i];
-		if (audio->GetCondId() != id)
-			continue;
+	if (changed == false)
+		return;
+
+	std::unordered_map<int, std::vector<oamlAudio*> >::iterator it = condIndex.find(id);
+	if (it == condIndex.end())
+		return;
+
+	std::vector<oamlAudio*>& audios = it->second;
+	for (size_t i=0; i<audios.size(); i++) {
+		oamlAudio *audio = audios[i];
 
 		if (curAudio != audio) {
 			// Audio isn't being played right now
@@ -160,13 +205,10 @@ void oamlMusicTrack::SetCondition(int id, int value) {
 }
 
 void oamlMusicTrack::PlayCondWithMovement(oamlAudio *audio) {
+	// Mix switches over once curAudio reaches its next movement boundary, or its end if that comes first
 	playCondAudio = audio;
-	playCondSamples = curAudio->GetBarsSamples(curAudio->GetMinMovementBars());
-	if (playCondSamples == 0)
-		return;
-
-	playCondSamples = (playCondSamples + curAudio->GetBarsSamples(curAudio->GetSamplesCount() / playCondSamples) * curAudio->GetMinMovementBars()) - curAudio->GetSamplesCount();
-//	printf("%s %d\n", __FUNCTION__, playCondSamples);
+	playCondPos = curAudio->GetNextBarsPos(curAudio->GetMinMovementBars());
+	playCondPending = true;
 }
 
 void oamlMusicTrack::PlayCond(oamlAudio *audio) {
@@ -180,20 +222,62 @@ void oamlMusicTrack::PlayCond(oamlAudio *audio) {
 	}
 }
 
+oamlRC oamlMusicTrack::Prepare() {
+	oamlRC rc = PrepareAudios(&introAudios);
+	if (rc != OAML_OK)
+		return rc;
+
+	rc = PrepareAudios(&loopAudios);
+	if (rc != OAML_OK) {
+		UnprepareAudios(&introAudios);
+		return rc;
+	}
+
+	rc = PrepareAudios(&randAudios);
+	if (rc != OAML_OK) {
+		UnprepareAudios(&introAudios);
+		UnprepareAudios(&loopAudios);
+		return rc;
+	}
+
+	rc = PrepareAudios(&condAudios);
+	if (rc != OAML_OK) {
+		UnprepareAudios(&introAudios);
+		UnprepareAudios(&loopAudios);
+		UnprepareAudios(&randAudios);
+		return rc;
+	}
+
+	return OAML_OK;
+}
+
+void oamlMusicTrack::Unprepare() {
+	UnprepareAudios(&introAudios);
+	UnprepareAudios(&loopAudios);
+	UnprepareAudios(&randAudios);
+	UnprepareAudios(&condAudios);
+}
+
 oamlRC oamlMusicTrack::Play() {
 	int doFade = 0;
 
-	if (lock > 0) {
-		return OAML_ERROR;
+	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetNameStr());
+
+	// Every play comes prepared, one reference is enough while we're still playing or fading out
+	if (prepared) {
+		Unprepare();
 	}
+	prepared = true;
 
-	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetNameStr());
 	fadeAudio = NULL;
+	playCondPending = false;
 
 	if (curAudio == NULL) {
 		doFade = 1;
 	}
 
+	// Conditions start over with every play
+	condValues.clear();
 	SetCondition(OAML_CONDID_MAIN_LOOP, 0);
 
 	playingOrder = 0;
@@ -347,49 +431,80 @@ void oamlMusicTrack::XFadePlay() {
 	}
 }
 
-void oamlMusicTrack::Mix(float *samples, int channels, bool debugClipping) {
+void oamlMusicTrack::Mix(float *samples, int frames, int channels, bool debugClipping) {
 	if (curAudio == NULL && tailAudio == NULL && fadeAudio == NULL)
 		return;
 
-	lock++;
+	while (frames > 0) {
+		if (curAudio == NULL && tailAudio == NULL && fadeAudio == NULL)
+			break;
 
-	if (curAudio) {
-		MixAudio(curAudio, samples, channels, debugClipping);
-	}
+		// Render up to the next point where one of our audios finishes or a condition has to be played
+		int count = frames;
+		if (curAudio) {
+			int left = (int)curAudio->GetFramesToEnd();
+			if (left < count) count = left;
+		}
+		if (tailAudio) {
+			int left = (int)tailAudio->GetFramesToEndTail(tailPos);
+			if (left < count) count = left;
+		}
+		if (fadeAudio) {
+			int left = (int)fadeAudio->GetFramesToEnd();
+			if (left < count) count = left;
+		}
+		if (playCondPending && curAudio) {
+			int left = (int)curAudio->GetFramesTo(playCondPos);
+			if (left < count) count = left;
+		}
 
-	if (tailAudio) {
-		tailPos = MixAudio(tailAudio, samples, channels, debugClipping, tailPos);
-		if (tailAudio->HasFinishedTail(tailPos))
-			tailAudio = NULL;
-	}
+		// Always advance at least one frame, same as the per-frame mixer did
+		if (count < 1) count = 1;
 
-	if (fadeAudio) {
-		MixAudio(fadeAudio, samples, channels, debugClipping);
-	}
+		if (curAudio) {
+			MixAudio(curAudio, samples, count, channels, debugClipping);
+		}
 
-	if (curAudio && curAudio->HasFinished()) {
-		tailAudio = curAudio;
-		tailPos = curAudio->GetSamplesCount();
+		if (tailAudio) {
+			tailPos = MixAudio(tailAudio, samples, count, channels, debugClipping, tailPos);
+			if (tailAudio->HasFinishedTail(tailPos))
+				tailAudio = NULL;
+		}
 
-		PlayNext();
-	}
+		if (fadeAudio) {
+			MixAudio(fadeAudio, samples, count, channels, debugClipping);
+		}
 
-	if (fadeAudio && fadeAudio->HasFinished()) {
-		fadeAudio = NULL;
-	}
+		if (curAudio) {
+			bool finished = curAudio->HasFinished();
+			if (finished) {
+				tailAudio = curAudio;
+				tailPos = curAudio->GetSamplesCount();
+			}
 
-	if (playCondSamples > 0) {
-		playCondSamples--;
-		if (playCondSamples == 0) {
-			PlayCond(playCondAudio);
+			if (playCondPending && (finished || curAudio->GetSamplesCount() >= playCondPos)) {
+				// Reached the movement boundary, a finished audio is left playing its tail
+				playCondPending = false;
+				if (finished) {
+					curAudio = NULL;
+				}
+				PlayCond(playCondAudio);
+			} else if (finished) {
+				PlayNext();
+			}
 		}
-	}
 
-	if (curAudio == NULL && tailAudio == NULL && fadeAudio == NULL) {
-		FreeMemory();
-	}
+		if (fadeAudio && fadeAudio->HasFinished()) {
+			fadeAudio = NULL;
+		}
+
+		if (curAudio == NULL && tailAudio == NULL && fadeAudio == NULL) {
+			Release();
+		}
 
-	lock--;
+		samples+= count * channels;
+		frames-= count;
+	}
 }
 
 bool oamlMusicTrack::IsPlaying() {
@@ -429,6 +544,8 @@ std::string oamlMusicTrack::GetPlayingInfo() {
 }
 
 void oamlMusicTrack::Stop() {
+	playCondPending = false;
+
 	if (curAudio) {
 		if (fadeOut) {
 			fadeAudio = curAudio;
@@ -441,80 +558,10 @@ void oamlMusicTrack::Stop() {
 	playing = false;
 
 	if (curAudio == NULL && tailAudio == NULL && fadeAudio == NULL) {
-		FreeMemory();
+		Release();
 	}
 }
 
-oamlRC oamlMusicTrack::Load() {
-	for (std::vector<oamlAudio*>::iterator it=loopAudios.begin(); it<loopAudios.end(); ++it) {
-		oamlAudio *audio = *it;
-		oamlRC ret = audio->Load();
-		if (ret != OAML_OK) return ret;
-	}
-
-	return OAML_OK;
-}
-
-float oamlMusicTrack::LoadProgress() {
-	int samples;
-
-	if (filesSamples == 0) {
-		// Calculate the total size of the audio loops to read
-
-		samples = GetFilesSamplesFor(&introAudios);
-		if (samples == -1)
-			return -1.f;
-		filesSamples+= samples;
-
-		samples = GetFilesSamplesFor(&loopAudios);
-		if (samples == -1)
-			return -1.f;
-		filesSamples+= samples;
-
-		samples = GetFilesSamplesFor(&randAudios);
-		if (samples == -1)
-			return -1.f;
-		filesSamples+= samples;
-
-		samples = GetFilesSamplesFor(&condAudios);
-		if (samples == -1)
-			return -1.f;
-		filesSamples+= samples;
-	}
-
-	if (filesSamples == 0) {
-		return -1.f;
-	}
-
-	int totalSamplesRead = 0;
-
-	samples = LoadProgressFor(&introAudios);
-	if (samples == -1) {
-		return -1.f;
-	}
-	totalSamplesRead+= samples;
-
-	samples = LoadProgressFor(&loopAudios);
-	if (samples == -1) {
-		return -1.f;
-	}
-	totalSamplesRead+= samples;
-
-	samples = LoadProgressFor(&randAudios);
-	if (samples == -1) {
-		return -1.f;
-	}
-	totalSamplesRead+= samples;
-
-	samples = LoadProgressFor(&condAudios);
-	if (samples == -1) {
-		return -1.f;
-	}
-	totalSamplesRead+= samples;
-
-	return float(double(totalSamplesRead) / double(filesSamples));
-}
-
 void oamlMusicTrack::ReadInfo(oamlTrackInfo *info) {
 	oamlTrack::ReadInfo(info);
 
@@ -524,13 +571,17 @@ void oamlMusicTrack::ReadInfo(oamlTrackInfo *info) {
 	ReadAudiosInfo(&condAudios, info);
 }
 
-void oamlMusicTrack::FreeMemory() {
-	FreeAudiosMemory(&introAudios);
-	FreeAudiosMemory(&loopAudios);
-	FreeAudiosMemory(&randAudios);
-	FreeAudiosMemory(&condAudios);
+void oamlMusicTrack::Release() {
+	ReleaseAudios(&introAudios);
+	ReleaseAudios(&loopAudios);
+	ReleaseAudios(&randAudios);
+	ReleaseAudios(&condAudios);
 
-	filesSamples = 0;
+	// Still playing while waiting on a condition, otherwise it needs preparing again to play
+	if (playing == false && prepared) {
+		Unprepare();
+		prepared = false;
+	}
 }
 
 void oamlMusicTrack::GetAudioList(std::vector<std::string>& list) {
@@ -540,3 +591,10 @@ void oamlMusicTrack::GetAudioList(std::vector<std::string>& list) {
 	FillAudiosList(&condAudios, list);
 }
 
+void oamlMusicTrack::GetAudioFiles(std::vector<oamlAudioFile*>& list) {
+	FillAudioFilesList(&introAudios, list);
+	FillAudioFilesList(&loopAudios, list);
+	FillAudioFilesList(&randAudios, list);
+	FillAudioFilesList(&condAudios, list);
+}
+
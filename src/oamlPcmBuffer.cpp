@@ -0,0 +1,304 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+// Same scale used by __oamlInteger24ToFloat, so int16 samples mix exactly as they did before
+static const float PCM_Q = 1.0f / (0x7fffff + 0.5f);
+
+oamlPcmBuffer::oamlPcmBuffer() : count(0) {
+	useFloat = false;
+	reserved = false;
+
+	mapped = NULL;
+	mappedData = NULL;
+	mappedFormat = OAML_PCM_NONE;
+}
+
+oamlPcmBuffer::~oamlPcmBuffer() {
+	Free();
+}
+
+void oamlPcmBuffer::SetFormat(int bytesPerSample) {
+	Free();
+
+	useFloat = bytesPerSample > 2;
+}
+
+void oamlPcmBuffer::Reserve(unsigned int samples) {
+	reserved = samples > 0;
+
+	if (useFloat) {
+		pcmFloat.resize(samples);
+	} else {
+		pcm16.resize(samples);
+	}
+}
+
+unsigned int oamlPcmBuffer::MakeRoom(unsigned int pos, unsigned int samples) {
+	size_t capacity = useFloat ? pcmFloat.size() : pcm16.size();
+
+	if (reserved == false) {
+		// Size unknown up front, grow as we go
+		if (pos + samples > capacity) {
+			capacity = pos + samples;
+			if (useFloat) {
+				pcmFloat.resize(capacity);
+			} else {
+				pcm16.resize(capacity);
+			}
+		}
+	} else if (pos + samples > capacity) {
+		// Never reallocate under a reader, drop anything past the size the file reported
+		samples = (unsigned int)(capacity - pos);
+	}
+
+	return samples;
+}
+
+void oamlPcmBuffer::Decode(const uint8_t *data, unsigned int samples, int bytesPerSample) {
+	unsigned int pos = count.load(std::memory_order_relaxed);
+
+	samples = MakeRoom(pos, samples);
+	if (samples == 0)
+		return;
+
+	if (useFloat) {
+		float *dst = &pcmFloat[pos];
+
+		if (bytesPerSample == 4) {
+			// Already float, files convert 32 bit integers themselves
+			memcpy(dst, data, samples * sizeof(float));
+		} else if (bytesPerSample == 3) {
+			for (unsigned int i=0; i<samples; i++) {
+				const uint8_t *p = data + i*3;
+				dst[i] = __oamlInteger24ToFloat(p[0] | (p[1] << 8) | (p[2] << 16));
+			}
+		}
+	} else {
+		int16_t *dst = &pcm16[pos];
+
+		if (bytesPerSample == 2) {
+			memcpy(dst, data, samples * sizeof(int16_t));
+		} else if (bytesPerSample == 1) {
+			// 8bit pcm data is unsigned
+			for (unsigned int i=0; i<samples; i++) {
+				dst[i] = (int16_t)((data[i] - 128) * 256);
+			}
+		}
+	}
+
+	count.store(pos + samples, std::memory_order_release);
+}
+
+float* oamlPcmBuffer::GetAppendFloats(unsigned int& samples) {
+	if (useFloat == false) {
+		samples = 0;
+		return NULL;
+	}
+
+	unsigned int pos = count.load(std::memory_order_relaxed);
+	samples = MakeRoom(pos, samples);
+	if (samples == 0)
+		return NULL;
+
+	return &pcmFloat[pos];
+}
+
+void oamlPcmBuffer::CommitAppend(unsigned int samples) {
+	unsigned int pos = count.load(std::memory_order_relaxed);
+	count.store(pos + samples, std::memory_order_release);
+}
+
+void oamlPcmBuffer::Map(oamlMappedFile *file, const uint8_t *data, unsigned int samples, int format) {
+	Free();
+
+	mapped = file;
+	mappedData = data;
+	mappedFormat = format;
+
+	count.store(samples, std::memory_order_release);
+}
+
+void oamlPcmBuffer::MixMapped(float *samples, unsigned int pos, unsigned int samplesCount, float gain) const {
+	// Same values Decode() followed by Mix() would give
+	switch (mappedFormat) {
+		case OAML_PCM_U8: {
+			const uint8_t *src = mappedData + pos;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				int16_t value = (int16_t)((src[i] - 128) * 256);
+				samples[i]+= ((value * 256 + 0.5f) * PCM_Q) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S8: {
+			const uint8_t *src = mappedData + pos;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				int16_t value = (int16_t)((int8_t)src[i] * 256);
+				samples[i]+= ((value * 256 + 0.5f) * PCM_Q) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S16LE: {
+			const uint8_t *src = mappedData + pos*2;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				int16_t value = (int16_t)(src[i*2] | (src[i*2+1] << 8));
+				samples[i]+= ((value * 256 + 0.5f) * PCM_Q) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S16BE: {
+			const uint8_t *src = mappedData + pos*2;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				int16_t value = (int16_t)((src[i*2] << 8) | src[i*2+1]);
+				samples[i]+= ((value * 256 + 0.5f) * PCM_Q) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S24LE: {
+			const uint8_t *src = mappedData + pos*3;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				const uint8_t *p = src + i*3;
+				samples[i]+= __oamlInteger24ToFloat(p[0] | (p[1] << 8) | (p[2] << 16)) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S24BE: {
+			const uint8_t *src = mappedData + pos*3;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				const uint8_t *p = src + i*3;
+				samples[i]+= __oamlInteger24ToFloat(p[2] | (p[1] << 8) | (p[0] << 16)) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S32LE: {
+			const uint8_t *src = mappedData + pos*4;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				const uint8_t *p = src + i*4;
+				samples[i]+= __oamlInteger32ToFloat((int32_t)(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24))) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_S32BE: {
+			const uint8_t *src = mappedData + pos*4;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				const uint8_t *p = src + i*4;
+				samples[i]+= __oamlInteger32ToFloat((int32_t)(p[3] | (p[2] << 8) | (p[1] << 16) | ((uint32_t)p[0] << 24))) * gain;
+			}
+			break;
+		}
+
+		case OAML_PCM_F32LE: {
+			const uint8_t *src = mappedData + pos*4;
+			for (unsigned int i=0; i<samplesCount; i++) {
+				float value;
+				memcpy(&value, src + i*4, sizeof(float));
+				samples[i]+= value * gain;
+			}
+			break;
+		}
+	}
+}
+
+void oamlPcmBuffer::Mix(float *samples, unsigned int pos, unsigned int samplesCount, float gain) const {
+	unsigned int size = Size();
+	if (pos >= size)
+		return;
+
+	if (pos + samplesCount > size) {
+		samplesCount = size - pos;
+	}
+
+	if (mapped) {
+		MixMapped(samples, pos, samplesCount, gain);
+		return;
+	}
+
+	if (useFloat) {
+		const float *src = &pcmFloat[pos];
+		for (unsigned int i=0; i<samplesCount; i++) {
+			samples[i]+= src[i] * gain;
+		}
+	} else {
+		const int16_t *src = &pcm16[pos];
+		for (unsigned int i=0; i<samplesCount; i++) {
+			samples[i]+= ((src[i] * 256 + 0.5f) * PCM_Q) * gain;
+		}
+	}
+}
+
+void oamlPcmBuffer::ToFloat(const uint8_t *data, float *samples, unsigned int samplesCount, int bytesPerSample) {
+	// Gives the exact values Mix() would, so streamed and resident audio sound the same
+	if (bytesPerSample == 4) {
+		memcpy(samples, data, samplesCount * sizeof(float));
+	} else if (bytesPerSample == 3) {
+		for (unsigned int i=0; i<samplesCount; i++) {
+			const uint8_t *p = data + i*3;
+			samples[i] = __oamlInteger24ToFloat(p[0] | (p[1] << 8) | (p[2] << 16));
+		}
+	} else if (bytesPerSample == 2) {
+		for (unsigned int i=0; i<samplesCount; i++) {
+			int16_t value = (int16_t)(data[i*2] | (data[i*2+1] << 8));
+			samples[i] = (value * 256 + 0.5f) * PCM_Q;
+		}
+	} else if (bytesPerSample == 1) {
+		for (unsigned int i=0; i<samplesCount; i++) {
+			int16_t value = (int16_t)((data[i] - 128) * 256);
+			samples[i] = (value * 256 + 0.5f) * PCM_Q;
+		}
+	}
+}
+
+size_t oamlPcmBuffer::GetMemorySize() const {
+	return pcm16.capacity() * sizeof(int16_t) + pcmFloat.capacity() * sizeof(float);
+}
+
+void oamlPcmBuffer::Free() {
+	count.store(0, std::memory_order_release);
+
+	std::vector<int16_t> tmp16;
+	pcm16.swap(tmp16);
+
+	std::vector<float> tmpFloat;
+	pcmFloat.swap(tmpFloat);
+
+	if (mapped) {
+		delete mapped;
+		mapped = NULL;
+	}
+	mappedData = NULL;
+	mappedFormat = OAML_PCM_NONE;
+
+	reserved = false;
+}
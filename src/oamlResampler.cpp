@@ -0,0 +1,274 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "oamlCommon.h"
+
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+	while (b) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static double besselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k=1; k<32; k++) {
+		term*= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum+= term;
+	}
+	return sum;
+}
+
+static float dotProduct(const float *a, const float *b, unsigned int count) {
+	// Eight separate sums, one per lane, count is always a multiple of 8. Every path adds them up in the same
+	// order with separate multiplies and adds, so the output doesn't depend on the instruction set
+	float sum[8];
+
+#if defined(OAML_AVX2)
+	__m256 acc = _mm256_setzero_ps();
+	for (unsigned int i=0; i<count; i+= 8) {
+		acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+	}
+	_mm256_storeu_ps(sum, acc);
+#elif defined(OAML_SSE2)
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	for (unsigned int i=0; i<count; i+= 8) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
+	}
+	_mm_storeu_ps(sum, acc0);
+	_mm_storeu_ps(sum+4, acc1);
+#elif defined(OAML_NEON)
+	float32x4_t acc0 = vdupq_n_f32(0.f);
+	float32x4_t acc1 = vdupq_n_f32(0.f);
+	for (unsigned int i=0; i<count; i+= 8) {
+		acc0 = vaddq_f32(acc0, vmulq_f32(vld1q_f32(a+i), vld1q_f32(b+i)));
+		acc1 = vaddq_f32(acc1, vmulq_f32(vld1q_f32(a+i+4), vld1q_f32(b+i+4)));
+	}
+	vst1q_f32(sum, acc0);
+	vst1q_f32(sum+4, acc1);
+#else
+	for (int j=0; j<8; j++) {
+		sum[j] = 0.f;
+	}
+	for (unsigned int i=0; i<count; i+= 8) {
+		for (int j=0; j<8; j++) {
+			sum[j]+= a[i+j] * b[i+j];
+		}
+	}
+#endif
+
+	return ((sum[0] + sum[4]) + (sum[1] + sum[5])) + ((sum[2] + sum[6]) + (sum[3] + sum[7]));
+}
+
+oamlResampler::oamlResampler(unsigned int _channels, unsigned int inRate, unsigned int outRate) {
+	channels = _channels;
+
+	uint64_t d = gcd(inRate, outRate);
+	up = outRate / d;
+	down = inRate / d;
+
+	// Ratios with too many phases use the nearest of a fixed set
+	phases = up < OAML_RESAMPLER_MAX_PHASES ? (unsigned int)up : OAML_RESAMPLER_MAX_PHASES;
+
+	// Going down the filter gets narrower, so it needs more taps to keep the same steepness
+	unsigned int widen = (unsigned int)((down + up - 1) / up);
+	if (widen > 4) widen = 4;
+	taps = OAML_RESAMPLER_TAPS * (widen > 1 ? widen : 1);
+
+	BuildFilter();
+
+	history.resize(channels);
+	pending.resize(channels);
+	Reset(0);
+}
+
+oamlResampler::~oamlResampler() {
+}
+
+uint64_t oamlResampler::GetOutputFrames(uint64_t inputFrames, unsigned int inRate, unsigned int outRate) {
+	return (inputFrames * outRate + inRate - 1) / inRate;
+}
+
+void oamlResampler::BuildFilter() {
+	// Cut off a bit below the lower of both nyquists, the rest of the way is the filter's transition band
+	double ratio = up < down ? double(up) / double(down) : 1.0;
+	double cutoff = 0.46 * ratio;
+	double beta = 8.0;
+	double half = taps / 2;
+	double i0beta = besselI0(beta);
+	const double pi = 3.14159265358979323846;
+
+	coeffs.resize(phases * taps);
+	for (unsigned int p=0; p<phases; p++) {
+		float *h = &coeffs[p * taps];
+
+		double sum = 0.0;
+		for (unsigned int k=0; k<taps; k++) {
+			// Distance from the output position to input sample k of the window
+			double t = double(k) - (half - 1) - double(p) / phases;
+			double x = 2.0 * cutoff * t;
+			double sinc = fabs(x) < 1e-9 ? 1.0 : sin(pi * x) / (pi * x);
+			double w = t / half;
+			double window = fabs(w) >= 1.0 ? 0.0 : besselI0(beta * sqrt(1.0 - w * w)) / i0beta;
+
+			double value = sinc * window;
+			h[k] = (float)value;
+			sum+= value;
+		}
+
+		// Unity gain on every phase, so there's no ripple at the ratio's rate
+		for (unsigned int k=0; k<taps; k++) {
+			h[k] = (float)(h[k] / sum);
+		}
+	}
+}
+
+int64_t oamlResampler::GetFirstInput(uint64_t frame) const {
+	return int64_t((frame * down) / up) - int64_t(taps / 2 - 1);
+}
+
+uint64_t oamlResampler::Reset(uint64_t frame) {
+	outPos = frame;
+	outEnd = (uint64_t)-1;
+	ended = false;
+	pendingPos = channels;
+
+	// Anything before the start of the file is silence
+	int64_t first = GetFirstInput(frame);
+	historyStart = first;
+	for (unsigned int c=0; c<channels; c++) {
+		history[c].clear();
+		if (first < 0) {
+			history[c].resize((size_t)-first, 0.f);
+		}
+	}
+
+	return first < 0 ? 0 : (uint64_t)first;
+}
+
+void oamlResampler::Write(const float *samples, unsigned int frames) {
+	if (ended || frames == 0)
+		return;
+
+	for (unsigned int c=0; c<channels; c++) {
+		std::vector<float>& h = history[c];
+		size_t pos = h.size();
+		h.resize(pos + frames);
+		for (unsigned int i=0; i<frames; i++) {
+			h[pos + i] = samples[i * channels + c];
+		}
+	}
+}
+
+void oamlResampler::End() {
+	if (ended)
+		return;
+
+	// Output stops where the input would, pad with enough silence for the filter to get there
+	uint64_t inputFrames = uint64_t(historyStart + (int64_t)history[0].size());
+	outEnd = (inputFrames * up + down - 1) / down;
+	for (unsigned int c=0; c<channels; c++) {
+		history[c].resize(history[c].size() + taps, 0.f);
+	}
+	ended = true;
+}
+
+bool oamlResampler::ComputeFrame(float *frame) {
+	if (outPos >= outEnd)
+		return false;
+
+	uint64_t pos = outPos * down;
+	uint64_t index = pos / up;
+	uint64_t frac = pos % up;
+
+	unsigned int phase = (unsigned int)frac;
+	if (phases < up) {
+		phase = (unsigned int)((frac * phases + up / 2) / up);
+		if (phase == phases) {
+			phase = 0;
+			index++;
+		}
+	}
+
+	// Every input the filter covers has to be here already
+	int64_t first = int64_t(index) - int64_t(taps / 2 - 1);
+	if (first < historyStart || first + taps > historyStart + (int64_t)history[0].size())
+		return false;
+
+	const float *h = &coeffs[phase * taps];
+	for (unsigned int c=0; c<channels; c++) {
+		frame[c] = dotProduct(h, &history[c][(size_t)(first - historyStart)], taps);
+	}
+
+	outPos++;
+	return true;
+}
+
+void oamlResampler::Trim() {
+	int64_t first = GetFirstInput(outPos);
+	if (first - historyStart < 16384)
+		return;
+
+	size_t drop = (size_t)(first - historyStart);
+	for (unsigned int c=0; c<channels; c++) {
+		history[c].erase(history[c].begin(), history[c].begin() + drop);
+	}
+	historyStart = first;
+}
+
+unsigned int oamlResampler::Read(float *samples, unsigned int count) {
+	unsigned int done = 0;
+
+	while (done < count && pendingPos < channels) {
+		samples[done++] = pending[pendingPos++];
+	}
+
+	// Whole frames go straight to the output
+	while (count - done >= channels) {
+		if (ComputeFrame(samples + done) == false)
+			break;
+		done+= channels;
+	}
+
+	if (done < count && count - done < channels) {
+		if (ComputeFrame(&pending[0])) {
+			pendingPos = 0;
+			while (done < count) {
+				samples[done++] = pending[pendingPos++];
+			}
+		}
+	}
+
+	Trim();
+	return done;
+}
@@ -0,0 +1,639 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlSample::oamlSample(std::string _filename, oamlFileCallbacks2 *cbs, oamlSampleCache *_cache, bool _verbose) {
+	filename = _filename;
+	fcbs = cbs;
+	cache = _cache;
+	verbose = _verbose;
+
+	handle = NULL;
+	compressed = NULL;
+
+	bytesPerSample = 0;
+	samplesPerSec = 0;
+	totalSamples = 0;
+	channelCount = 0;
+
+	outputRate = 0;
+	resampler = NULL;
+
+	hasInfo = false;
+	memset(&info, 0, sizeof(info));
+
+	residentSamples = 0;
+	streamRequested = false;
+	streaming = false;
+
+	loadFailed = false;
+
+	refs = 0;
+	users = 0;
+	pins = 0;
+	lastUsed = 0;
+	memorySize = 0;
+}
+
+oamlSample::~oamlSample() {
+	CloseHandle();
+
+	FreeCompressed();
+	SetMemorySize(0);
+}
+
+audioFile* oamlSample::OpenHandle(const char *filename, oamlFileCallbacks2 *cbs, oamlMemoryFile *source) {
+	audioFile *file;
+
+	std::string name = filename;
+	std::string ext = name.substr(name.find_last_of(".") + 1);
+	if (ext == "wav" || ext == "wave") {
+		file = new wavFile(cbs);
+	} else if (ext == "aif" || ext == "aiff") {
+		file = (audioFile*)new aifFile(cbs);
+#ifdef __HAVE_OGG
+	} else if (ext == "ogg") {
+		file = (audioFile*)new oggFile(cbs);
+#endif
+	} else if (ext == "qoa") {
+		file = (audioFile*)new qoaFile(cbs);
+	} else {
+		fprintf(stderr, "liboaml: Unknown audio format: '%s'\n", filename);
+		return NULL;
+	}
+
+	file->SetSource(source);
+	if (file->Open(filename) == -1) {
+		fprintf(stderr, "liboaml: Error opening: '%s'\n", filename);
+		delete file;
+		return NULL;
+	}
+
+	return file;
+}
+
+bool oamlSample::IsCompressedFile(const char *filename) {
+	std::string name = filename;
+	std::string ext = name.substr(name.find_last_of(".") + 1);
+	return ext == "ogg" || ext == "qoa";
+}
+
+bool oamlSample::ProbeInfo(const char *filename, oamlFileCallbacks2 *cbs, oamlFileInfo *info) {
+	audioFile *file = OpenHandle(filename, cbs);
+	if (file == NULL)
+		return false;
+
+	info->channels = file->GetChannels();
+	info->samplesPerSec = file->GetSamplesPerSec();
+	info->totalSamples = file->GetTotalSamples();
+	info->bytesPerSample = file->GetBytesPerSample();
+	info->pcmFormat = file->GetPcmFormat();
+
+	file->Close();
+	delete file;
+
+	info->fileSize = GetFileSize(filename, cbs);
+	return true;
+}
+
+unsigned int oamlSample::GetFileSize(const char *filename, oamlFileCallbacks2 *cbs) {
+	void *fd = cbs->open(filename);
+	if (fd == NULL)
+		return 0;
+
+	long size;
+	if (cbs->size) {
+		size = cbs->size(fd);
+	} else if (cbs->seek(fd, 0, SEEK_END) == 0) {
+		size = cbs->tell(fd);
+	} else {
+		size = -1;
+	}
+	cbs->close(fd);
+
+	// 0 is unknown, a header with it is never trusted
+	if (size <= 0)
+		return 0;
+
+	return (unsigned int)size;
+}
+
+oamlRC oamlSample::OpenFile() {
+	handle = OpenHandle(GetFilenameStr(), fcbs, compressed);
+	if (handle == NULL)
+		return OAML_ERROR;
+
+	bytesPerSample = handle->GetBytesPerSample();
+	samplesPerSec = handle->GetSamplesPerSec() * handle->GetChannels();
+	totalSamples = handle->GetTotalSamples();
+	channelCount = handle->GetChannels();
+
+	// Remember the header so the file doesn't need probing again, even after it's evicted
+	info.channels = channelCount;
+	info.samplesPerSec = handle->GetSamplesPerSec();
+	info.totalSamples = totalSamples;
+	info.bytesPerSample = bytesPerSample;
+	info.pcmFormat = handle->GetPcmFormat();
+	info.fileSize = GetFileSize(GetFilenameStr(), fcbs);
+	hasInfo = true;
+	cache->StoreInfo(filename, info);
+	ApplyOutputRate();
+
+	// Uncompressed files that could be mapped are used in place, there's nothing to decode or stream
+	const uint8_t *mappedData = handle->GetMappedData();
+	if (mappedData && outputRate == 0) {
+		pcm.SetFormat(bytesPerSample);
+		pcm.Map(handle->DetachMapping(), mappedData, totalSamples, handle->GetPcmFormat());
+		residentSamples = totalSamples;
+		streaming = false;
+		SetMemorySize(pcm.GetMemorySize());
+
+		handle->Close();
+		delete handle;
+		handle = NULL;
+		return OAML_OK;
+	}
+
+	SetupBuffers();
+
+	if (outputRate > 0) {
+		if (resampler) {
+			delete resampler;
+		}
+		resampler = new oamlResampler(channelCount, info.samplesPerSec, outputRate);
+		resampleBuffer.resize(4096 - 4096 % channelCount);
+	}
+
+	return OAML_OK;
+}
+
+void oamlSample::CloseHandle() {
+	if (handle) {
+		handle->Close();
+		delete handle;
+		handle = NULL;
+	}
+
+	if (resampler) {
+		delete resampler;
+		resampler = NULL;
+	}
+}
+
+void oamlSample::SetupBuffers() {
+	// Compressed files can be kept in memory as they are, then streamed from there instead of being decoded whole
+	if (compressed == NULL && cache->GetCompressedPlayback() && IsCompressedFile(GetFilenameStr())) {
+		LoadCompressed();
+	}
+
+	// Long files are streamed from disk, only their start is kept decoded so they can begin playing right away
+	size_t decodedSize = size_t(totalSamples) * (bytesPerSample > 2 || outputRate > 0 ? sizeof(float) : sizeof(int16_t));
+	size_t threshold = cache->GetStreamingThreshold();
+	streaming = streamRequested || compressed != NULL || (threshold > 0 && decodedSize > threshold);
+
+	residentSamples = totalSamples;
+	if (streaming) {
+		unsigned int head = (unsigned int)((uint64_t)samplesPerSec * OAML_STREAM_HEAD_MS / 1000);
+		if (channelCount > 0) {
+			head-= head % channelCount;
+		}
+		if (head < residentSamples) {
+			residentSamples = head;
+		}
+	}
+
+	// Allocate the whole decoded size up front so loading never has to grow the buffers, resampled data is always float
+	pcm.SetFormat(outputRate > 0 ? 4 : bytesPerSample);
+	pcm.Reserve(residentSamples);
+	readBuffer.reserve(4096*bytesPerSample);
+	SetMemorySize(pcm.GetMemorySize() + (compressed ? compressed->GetSize() : 0));
+}
+
+void oamlSample::LoadCompressed() {
+	compressed = new oamlMemoryFile();
+	if (compressed->Load(GetFilenameStr(), fcbs) == false) {
+		// Falls back to decoding or streaming it from disk
+		fprintf(stderr, "liboaml: Error loading '%s' into memory\n", GetFilenameStr());
+		FreeCompressed();
+		return;
+	}
+
+	if (verbose) __oamlLog("%s %s %lu\n", __FUNCTION__, GetFilenameStr(), (unsigned long)compressed->GetSize());
+}
+
+void oamlSample::FreeCompressed() {
+	// Streams still playing it keep their own reference
+	if (compressed) {
+		compressed->Release();
+		compressed = NULL;
+	}
+}
+
+void oamlSample::SetInfo(const oamlFileInfo& fileInfo) {
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	if (fileInfo.channels == 0 || fileInfo.bytesPerSample == 0)
+		return;
+
+	info = fileInfo;
+	hasInfo = true;
+
+	// Once opened the values read from the file itself are used
+	if (handle == NULL && pcm.Size() == 0 && streaming == false) {
+		ResetInfo();
+	}
+}
+
+void oamlSample::ResetInfo() {
+	bytesPerSample = info.bytesPerSample;
+	samplesPerSec = info.samplesPerSec * info.channels;
+	totalSamples = info.totalSamples;
+	channelCount = info.channels;
+	ApplyOutputRate();
+}
+
+void oamlSample::ApplyOutputRate() {
+	// Files at another rate than the output are converted as they're decoded, from here on everything sees the output rate
+	unsigned int rate = cache->GetOutputRate();
+	unsigned int fileRate = channelCount > 0 ? samplesPerSec / channelCount : 0;
+
+	outputRate = 0;
+	if (rate == 0 || fileRate == 0 || rate == fileRate)
+		return;
+
+	outputRate = rate;
+	totalSamples = (unsigned int)oamlResampler::GetOutputFrames(totalSamples / channelCount, fileRate, rate) * channelCount;
+	samplesPerSec = rate * channelCount;
+}
+
+bool oamlSample::IsRateStale() {
+	// Same as ApplyOutputRate() would pick with the file's header
+	unsigned int rate = cache->GetOutputRate();
+	unsigned int fileRate = hasInfo ? info.samplesPerSec : 0;
+	if (rate == 0 || fileRate == 0 || rate == fileRate) {
+		rate = 0;
+	}
+
+	return rate != outputRate;
+}
+
+bool oamlSample::CanOpenFromInfo() {
+	if (hasInfo == false || info.fileSize == 0)
+		return false;
+
+	// Files that would be mapped have to be opened for it
+	if (info.pcmFormat != OAML_PCM_NONE && fcbs->map != NULL)
+		return false;
+
+	// The header may come from compiled defs, don't use it if the file changed since. The file callbacks
+	// have no modification time, so a change that keeps the same size isn't noticed
+	return GetFileSize(GetFilenameStr(), fcbs) == info.fileSize;
+}
+
+bool oamlSample::WillStream() {
+	// Same as SetupBuffers() decides, before loading anything
+	if (streamRequested || (cache->GetCompressedPlayback() && IsCompressedFile(GetFilenameStr())))
+		return true;
+
+	size_t decodedSize = size_t(totalSamples) * (bytesPerSample > 2 || outputRate > 0 ? sizeof(float) : sizeof(int16_t));
+	size_t threshold = cache->GetStreamingThreshold();
+	return threshold > 0 && decodedSize > threshold;
+}
+
+oamlRC oamlSample::Open() {
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	// The output rate changed while this was playing, so oamlSampleCache couldn't drop it. Once the caller is
+	// its only user again it's converted to the new rate from scratch
+	if (IsRateStale() && users <= 1 && pins == 0) {
+		if (verbose) __oamlLog("%s %s output rate changed\n", __FUNCTION__, GetFilenameStr());
+
+		CloseHandle();
+		FreeData();
+	}
+
+	// A loader thread or another audio may already have the file opened or decoded
+	if (handle == NULL && pcm.Size() == 0 && streaming == false) {
+		// Streams open their own handles, so with the header known a streamed file doesn't need opening here
+		if (CanOpenFromInfo()) {
+			ResetInfo();
+			if (WillStream()) {
+				SetupBuffers();
+				if (streaming)
+					return OAML_OK;
+			}
+		}
+
+		// Anything else is opened now, the mixer only ever decodes from an open handle
+		oamlRC rc = OpenFile();
+
+		// Streams read through their own handles, the head is only decoded by Load()
+		if (rc == OAML_OK && streaming) {
+			CloseHandle();
+		}
+
+		return rc;
+	}
+
+	return OAML_OK;
+}
+
+oamlRC oamlSample::Load() {
+	int ret;
+	do {
+		// Only hold the lock for one chunk so the mixer isn't kept waiting
+		std::lock_guard<std::mutex> guard(decodeMutex);
+
+		if (handle == NULL) {
+			if (pcm.Size() > 0 || loadFailed)
+				break;
+
+			if (OpenFile() != OAML_OK) {
+				loadFailed = true;
+				return OAML_ERROR;
+			}
+		}
+
+		ret = Read();
+	} while (ret > 0);
+
+	if (loadFailed) return OAML_ERROR;
+	return OAML_OK;
+}
+
+float oamlSample::LoadProgress() {
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	if (loadFailed)
+		return -1.f;
+
+	if (handle == NULL) {
+		// Either fully decoded or not opened yet
+		return pcm.Size() > 0 ? 1.f : 0.f;
+	}
+
+	if (residentSamples == 0)
+		return 0.f;
+
+	return float(double(pcm.Size()) / double(residentSamples));
+}
+
+bool oamlSample::IsLoaded() {
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	return handle == NULL && (pcm.Size() > 0 || loadFailed);
+}
+
+int oamlSample::Read() {
+	// Files are opened by Open() or Load(), never from here as the mixer may be the one decoding
+	if (handle == NULL)
+		return -1;
+
+	if (resampler)
+		return ReadResampled();
+
+	// Float decoders write straight into the pcm buffer
+	if (handle->IsFloat())
+		return ReadFloat();
+
+	int readSize = 4096*bytesPerSample;
+	int ret = handle->Read(&readBuffer, readSize);
+	if (ret == -1) {
+		loadFailed = true;
+	}
+
+	if (ret < readSize) {
+		handle->Close();
+		delete handle;
+		handle = NULL;
+	}
+
+	if (ret > 0) {
+		// Convert the whole samples read into our pcm buffer, keep any trailing bytes for the next read
+		uint32_t bytes = readBuffer.size();
+		uint32_t used = (bytes / bytesPerSample) * bytesPerSample;
+		pcm.Decode(readBuffer.getRawData(), bytes / bytesPerSample, bytesPerSample);
+
+		if (used < bytes) {
+			uint8_t rest[4];
+			memcpy(rest, readBuffer.getRawData() + used, bytes - used);
+			readBuffer.clear();
+			readBuffer.putBytes(rest, bytes - used);
+		} else {
+			readBuffer.clear();
+		}
+
+		// Streamed files stop once their head is decoded
+		if (handle && pcm.Size() >= residentSamples) {
+			handle->Close();
+			delete handle;
+			handle = NULL;
+			readBuffer.clear();
+		}
+	}
+
+	return ret;
+}
+
+int oamlSample::ReadFloat() {
+	unsigned int count = 4096;
+	float *dst = pcm.GetAppendFloats(count);
+
+	int ret = 0;
+	if (dst) {
+		ret = handle->ReadFloat(dst, (int)count);
+		if (ret == -1) {
+			loadFailed = true;
+		} else if (ret > 0) {
+			pcm.CommitAppend(ret);
+		}
+	}
+
+	// Done at the end of the file, once there's no room left or when a streamed file has its head decoded
+	if (ret < (int)count || pcm.Size() >= residentSamples) {
+		handle->Close();
+		delete handle;
+		handle = NULL;
+	}
+
+	return ret;
+}
+
+int oamlSample::ReadResampled() {
+	// Decode a chunk at the file's rate, the resampler keeps what it needs of it for the next one
+	unsigned int count = (unsigned int)resampleBuffer.size();
+	unsigned int samplesRead = 0;
+	bool ended;
+	if (handle->IsFloat()) {
+		int ret = handle->ReadFloat(&resampleBuffer[0], (int)count);
+		if (ret == -1) {
+			loadFailed = true;
+		} else {
+			samplesRead = (unsigned int)ret;
+		}
+		ended = ret < (int)count;
+	} else {
+		int readSize = int(count*bytesPerSample);
+		int ret = handle->Read(&readBuffer, readSize);
+		if (ret == -1) {
+			loadFailed = true;
+		}
+		ended = ret < readSize;
+
+		samplesRead = readBuffer.size() / bytesPerSample;
+		if (samplesRead > count) {
+			samplesRead = count;
+		}
+		if (samplesRead > 0) {
+			oamlPcmBuffer::ToFloat(readBuffer.getRawData(), &resampleBuffer[0], samplesRead, bytesPerSample);
+		}
+		readBuffer.clear();
+	}
+
+	resampler->Write(&resampleBuffer[0], samplesRead / channelCount);
+	if (ended) {
+		resampler->End();
+	}
+
+	// Whatever comes out of it goes straight into the pcm buffer
+	unsigned int produced = 0;
+	for (;;) {
+		unsigned int room = residentSamples > pcm.Size() ? residentSamples - pcm.Size() : 0;
+		float *dst = room > 0 ? pcm.GetAppendFloats(room) : NULL;
+		if (dst == NULL)
+			break;
+
+		unsigned int ret = resampler->Read(dst, room);
+		if (ret == 0)
+			break;
+
+		pcm.CommitAppend(ret);
+		produced+= ret;
+	}
+
+	// Done at the end of the file or when a streamed file has its head decoded
+	if (ended || pcm.Size() >= residentSamples) {
+		CloseHandle();
+	}
+
+	return ended ? (int)produced : (int)samplesRead;
+}
+
+bool oamlSample::Decode(unsigned int samples) {
+	if (pcm.Size() >= samples)
+		return true;
+
+	// Never wait on a loader thread from the mixer, if it's busy with this file just use what's decoded so far
+	std::unique_lock<std::mutex> guard(decodeMutex, std::try_to_lock);
+	if (guard.owns_lock() == false)
+		return false;
+
+	if (samples > residentSamples) {
+		samples = residentSamples;
+	}
+
+	while (pcm.Size() < samples) {
+		if (Read() <= 0)
+			return false;
+	}
+
+	return true;
+}
+
+void oamlSample::Mix(float *samples, unsigned int pos, unsigned int count, float gain) {
+	// Decode anything that hasn't been loaded yet, streamed samples are never decoded from the mixer
+	if (streaming == false) {
+		Decode(pos + count);
+	}
+
+	pcm.Mix(samples, pos, count, gain);
+}
+
+void oamlSample::SetStreaming() {
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	// Takes effect the next time the file is opened
+	streamRequested = true;
+}
+
+oamlStream* oamlSample::CreateStream() {
+	unsigned int bufferSamples = (unsigned int)((uint64_t)samplesPerSec * OAML_STREAM_BUFFER_MS / 1000);
+	if (bufferSamples < 8192) {
+		bufferSamples = 8192;
+	}
+
+	return new oamlStream(filename, fcbs, compressed, bytesPerSample, totalSamples, bufferSamples, channelCount, info.samplesPerSec, outputRate);
+}
+
+void oamlSample::AddUser() {
+	// Taken under the decode lock so Evict() can't free the data once we're about to play it
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	users++;
+}
+
+void oamlSample::RemoveUser() {
+	if (users > 0) {
+		users--;
+	}
+}
+
+bool oamlSample::Evict() {
+	std::lock_guard<std::mutex> guard(decodeMutex);
+
+	// Don't touch samples that are playing, pinned or still being loaded
+	if (users > 0 || pins > 0 || handle != NULL)
+		return false;
+
+	if (pcm.Size() == 0 && memorySize == 0)
+		return false;
+
+	if (verbose) __oamlLog("%s %s\n", __FUNCTION__, GetFilenameStr());
+
+	FreeData();
+	return true;
+}
+
+void oamlSample::FreeData() {
+	pcm.Free();
+	readBuffer.clear();
+	readBuffer.free();
+	FreeCompressed();
+
+	ResetInfo();
+	residentSamples = 0;
+	streaming = false;
+	loadFailed = false;
+	SetMemorySize(0);
+}
+
+void oamlSample::SetMemorySize(size_t size) {
+	// The cache keeps a running total, so it can tell it's over budget without going through every sample
+	size_t old = memorySize.exchange(size);
+	cache->UpdateMemoryUsage(old, size);
+}
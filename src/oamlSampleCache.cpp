@@ -0,0 +1,177 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlSampleCache::oamlSampleCache() {
+	budget = OAML_CACHE_BUDGET_DEFAULT;
+	clock = 0;
+	memoryUsage = 0;
+	streamingThreshold = 0;
+	compressedPlayback = false;
+	outputRate = 0;
+}
+
+oamlSampleCache::~oamlSampleCache() {
+	for (std::map<std::string, oamlSample*>::iterator it=samples.begin(); it!=samples.end(); ++it) {
+		delete it->second;
+	}
+	samples.clear();
+}
+
+oamlSample* oamlSampleCache::Acquire(std::string filename, oamlFileCallbacks2 *cbs, bool verbose) {
+	std::lock_guard<std::mutex> guard(mutex);
+
+	oamlSample *sample;
+	std::map<std::string, oamlSample*>::iterator it = samples.find(filename);
+	if (it != samples.end()) {
+		sample = it->second;
+	} else {
+		sample = new oamlSample(filename, cbs, this, verbose);
+		samples[filename] = sample;
+
+		oamlFileInfo info;
+		if (GetInfo(filename, &info)) {
+			sample->SetInfo(info);
+		}
+	}
+
+	sample->refs++;
+	return sample;
+}
+
+void oamlSampleCache::Release(oamlSample *sample) {
+	if (sample == NULL)
+		return;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	sample->refs--;
+	if (sample->refs > 0)
+		return;
+
+	samples.erase(sample->GetFilename());
+	delete sample;
+}
+
+int oamlSampleCache::GetCount() {
+	std::lock_guard<std::mutex> guard(mutex);
+
+	return (int)samples.size();
+}
+
+size_t oamlSampleCache::GetMemoryUsage() {
+	return memoryUsage.load() + streamer.GetMemoryUsage();
+}
+
+void oamlSampleCache::Touch(oamlSample *sample) {
+	sample->lastUsed = ++clock;
+}
+
+static bool compareLastUsed(oamlSample *a, oamlSample *b) {
+	return a->GetLastUsed() < b->GetLastUsed();
+}
+
+void oamlSampleCache::Trim() {
+	// Called every frame by Update(), only go through the samples once we're over budget
+	if (memoryUsage.load() <= budget)
+		return;
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	size_t total = 0;
+	std::vector<oamlSample*> unused;
+	for (std::map<std::string, oamlSample*>::iterator it=samples.begin(); it!=samples.end(); ++it) {
+		oamlSample *sample = it->second;
+		size_t size = sample->GetMemorySize();
+		if (size == 0)
+			continue;
+
+		total+= size;
+		if (sample->GetUsers() == 0 && sample->IsPinned() == false) {
+			unused.push_back(sample);
+		}
+	}
+
+	if (total <= budget)
+		return;
+
+	// Evict the least recently used samples until we fit
+	std::sort(unused.begin(), unused.end(), compareLastUsed);
+	for (std::vector<oamlSample*>::iterator it=unused.begin(); it<unused.end() && total > budget; ++it) {
+		oamlSample *sample = *it;
+		size_t size = sample->GetMemorySize();
+		if (sample->Evict()) {
+			total-= size;
+		}
+	}
+}
+
+void oamlSampleCache::SetOutputRate(unsigned int rate) {
+	std::lock_guard<std::mutex> guard(mutex);
+
+	if (outputRate.load() == rate)
+		return;
+	outputRate = rate;
+
+	// Samples decoded for the old rate are dropped, they're converted to the new one when used again. Those in use
+	// are kept for whoever plays them now, oamlSample::Open() redoes them once that's over
+	for (std::map<std::string, oamlSample*>::iterator it=samples.begin(); it!=samples.end(); ++it) {
+		it->second->Evict();
+	}
+}
+
+void oamlSampleCache::StoreInfo(const std::string& filename, const oamlFileInfo& info) {
+	std::lock_guard<std::mutex> guard(infoMutex);
+
+	infos[filename] = info;
+}
+
+bool oamlSampleCache::GetInfo(const std::string& filename, oamlFileInfo *info) {
+	std::lock_guard<std::mutex> guard(infoMutex);
+
+	std::map<std::string, oamlFileInfo>::iterator it = infos.find(filename);
+	if (it == infos.end())
+		return false;
+
+	*info = it->second;
+	return true;
+}
+
+void oamlSampleCache::SetInfo(const std::string& filename, const oamlFileInfo& info) {
+	if (info.channels == 0 || info.bytesPerSample == 0)
+		return;
+
+	StoreInfo(filename, info);
+
+	std::lock_guard<std::mutex> guard(mutex);
+
+	std::map<std::string, oamlSample*>::iterator it = samples.find(filename);
+	if (it != samples.end()) {
+		it->second->SetInfo(info);
+	}
+}
@@ -30,9 +30,14 @@
 oamlSfxTrack::oamlSfxTrack(bool _verbose) {
 	name = "Sfx";
 	verbose = _verbose;
+	playingCount = 0;
 }
 
 oamlSfxTrack::~oamlSfxTrack() {
+	for (int i=0; i<playingCount; i++) {
+		playingAudios[i].audio->Unprepare();
+	}
+
 	ClearAudios(&sfxAudios);
 }
 
@@ -40,65 +45,94 @@ void oamlSfxTrack::AddAudio(oamlAudio *audio) {
 	ASSERT(audio != NULL);
 
 	sfxAudios.push_back(audio);
+	IndexAudio(audio);
+}
+
+void oamlSfxTrack::ReindexAudios() {
+	audioIndex.clear();
+	IndexAudios(&sfxAudios);
 }
 
-oamlAudio* oamlSfxTrack::GetAudio(std::string filename) {
-	return FindAudio(&sfxAudios, filename);
+int oamlSfxTrack::GetAudiosCount() const {
+	return (int)sfxAudios.size();
 }
 
 oamlRC oamlSfxTrack::Play(const char *name, float vol, float pan) {
-	if (lock > 0) {
-		// Play function can't be called while Mix is being run
-		return OAML_ERROR;
-	}
+	oamlAudio *audio = GetAudio(name);
+	if (audio == NULL)
+		return OAML_NOT_FOUND;
 
-	for (size_t i=0; i<sfxAudios.size(); i++) {
-		oamlAudio *audio = sfxAudios[i];
-		if (audio->GetName().compare(name) == 0) {
-			// We found our match, open and push it to playingAudios
-			audio->Open();
+	oamlRC rc = audio->Prepare();
+	if (rc != OAML_OK)
+		return rc;
 
-			sfxPlayInfo info = { audio, 0, vol, pan };
-			playingAudios.push_back(info);
-			return OAML_OK;
-		}
+	return PlayAudio(audio, vol, pan);
+}
+
+oamlRC oamlSfxTrack::PlayAudio(oamlAudio *audio, float vol, float pan) {
+	ASSERT(audio != NULL);
+
+	// The play comes prepared, it's given back once it finishes or if there's no room for it
+	if (playingCount >= OAML_SFX_MAX_PLAYING) {
+		audio->Unprepare();
+		return OAML_ERROR;
 	}
 
-	return OAML_NOT_FOUND;
+	// Open and push it to playingAudios
+	audio->Open();
+
+	sfxPlayInfo info = { audio, 0, vol, pan };
+	playingAudios[playingCount++] = info;
+	return OAML_OK;
 }
 
-void oamlSfxTrack::Mix(float *samples, int channels, bool debugClipping) {
-	if (playingAudios.size() == 0)
+void oamlSfxTrack::Mix(float *samples, int frames, int channels, bool debugClipping) {
+	if (playingCount == 0)
 		return;
 
-	// Prevent Play being called while this function is running
-	lock++;
-
-	for (std::vector<sfxPlayInfo>::iterator it=playingAudios.begin(); it!=playingAudios.end(); ++it) {
-		float buf[8];
+	float *buf = GetAudioBuffer(frames * channels);
+	for (sfxPlayInfo *it=playingAudios; it<playingAudios+playingCount; ++it) {
+		int count = (int)it->audio->GetFramesToEndTail(it->pos);
+		if (count > frames) count = frames;
+		if (count <= 0) continue;
 
 		// Read samples from our sfx to buf
-		it->pos = it->audio->ReadSamples(buf, channels, it->pos);
+		it->pos = it->audio->ReadSamples(buf, count, channels, it->pos);
 
 		// Apply the desired volume/panning
-		ApplyVolPanTo(buf, channels, it->vol, it->pan);
+		ApplyVolPanTo(buf, count, channels, it->vol, it->pan);
 
 		// Now finally mix the buf samples into the output samples array
-		for (int j=0; j<channels; j++) {
-			samples[j] = SafeAdd(samples[j], buf[j], debugClipping);
-		}
+		AddSamples(samples, buf, count*channels, 1.f, debugClipping);
 	}
 
-	for (std::vector<sfxPlayInfo>::iterator it=playingAudios.begin(); it!=playingAudios.end();) {
-		// Check if the sfx has finished playing and remove it if so
-		if (it->audio->HasFinishedTail(it->pos)) {
-			it = playingAudios.erase(it);
+	for (int i=0; i<playingCount;) {
+		// Check if the sfx has finished playing and remove it if so, keeping the rest in order
+		oamlAudio *audio = playingAudios[i].audio;
+		if (audio->HasFinishedTail(playingAudios[i].pos)) {
+			playingCount--;
+			for (int j=i; j<playingCount; j++) {
+				playingAudios[j] = playingAudios[j+1];
+			}
+
+			// Once no play of it is left its samples can be evicted again
+			audio->Unprepare();
+			if (IsAudioPlaying(audio) == false) {
+				audio->Release();
+			}
 		} else {
-			++it;
+			i++;
 		}
 	}
+}
+
+bool oamlSfxTrack::IsAudioPlaying(oamlAudio *audio) {
+	for (int i=0; i<playingCount; i++) {
+		if (playingAudios[i].audio == audio)
+			return true;
+	}
 
-	lock--;
+	return false;
 }
 
 bool oamlSfxTrack::IsPlaying() {
@@ -120,11 +154,15 @@ void oamlSfxTrack::ReadInfo(oamlTrackInfo *info) {
 	ReadAudiosInfo(&sfxAudios, info);
 }
 
-void oamlSfxTrack::FreeMemory() {
-	FreeAudiosMemory(&sfxAudios);
+void oamlSfxTrack::Release() {
+	ReleaseAudios(&sfxAudios);
 }
 
 void oamlSfxTrack::GetAudioList(std::vector<std::string>& list) {
 	FillAudiosList(&sfxAudios, list);
 }
 
+void oamlSfxTrack::GetAudioFiles(std::vector<oamlAudioFile*>& list) {
+	FillAudioFilesList(&sfxAudios, list);
+}
+
@@ -0,0 +1,325 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlStream::oamlStream(std::string _filename, oamlFileCallbacks2 *cbs, oamlMemoryFile *_source, unsigned int _bytesPerSample, unsigned int _totalSamples, unsigned int bufferSamples, unsigned int channels, unsigned int fileRate, unsigned int outputRate) :
+	readPos(0), writePos(0), seekPos(0), seekRequest(0), seekDone(0), closed(false) {
+	filename = _filename;
+	fcbs = cbs;
+
+	// Keep our own reference, the sample may be evicted while we're still playing
+	source = _source;
+	if (source) {
+		source->AddRef();
+	}
+
+	bytesPerSample = _bytesPerSample;
+	totalSamples = _totalSamples;
+
+	// Everything is allocated up front, the mixer only ever reads from the ring
+	ring.resize(bufferSamples);
+	decodeBuffer.resize(4096);
+	readBuffer.reserve(4096*bytesPerSample);
+
+	// Files at another rate than the output go through their own resampler, positions are then at the output rate
+	channelCount = channels;
+	resampler = NULL;
+	if (outputRate > 0 && outputRate != fileRate) {
+		resampler = new oamlResampler(channels, fileRate, outputRate);
+		inputBuffer.resize(4096 - 4096 % channels);
+	}
+
+	handle = NULL;
+	filePos = 0;
+	inputEnded = false;
+	failed = false;
+
+	// Makes the first Read() a seek, so the stream starts wherever the mixer does
+	nextPos = (unsigned int)-1;
+}
+
+oamlStream::~oamlStream() {
+	CloseHandle();
+
+	if (resampler) {
+		delete resampler;
+		resampler = NULL;
+	}
+
+	if (source) {
+		source->Release();
+		source = NULL;
+	}
+}
+
+bool oamlStream::OpenHandle() {
+	handle = oamlSample::OpenHandle(filename.c_str(), fcbs, source);
+	if (handle == NULL) {
+		failed = true;
+		return false;
+	}
+
+	readBuffer.clear();
+	filePos = 0;
+	inputEnded = false;
+	if (resampler) {
+		resampler->Reset(0);
+	}
+	return true;
+}
+
+void oamlStream::CloseHandle() {
+	if (handle) {
+		handle->Close();
+		delete handle;
+		handle = NULL;
+	}
+}
+
+unsigned int oamlStream::ReadFile(float *samples, unsigned int count) {
+	if (handle == NULL)
+		return 0;
+
+	// Float decoders write straight into the samples, nothing to convert
+	if (handle->IsFloat()) {
+		int ret = handle->ReadFloat(samples, (int)count);
+		if (ret < (int)count) {
+			inputEnded = true;
+		}
+
+		return ret > 0 ? (unsigned int)ret : 0;
+	}
+
+	int readSize = int(count*bytesPerSample - readBuffer.size());
+	int ret = handle->Read(&readBuffer, readSize);
+	if (ret < readSize) {
+		// End of file or a read error, either way there's nothing else coming. The handle stays open for the next seek
+		inputEnded = true;
+	}
+
+	uint32_t bytes = readBuffer.size();
+	unsigned int samplesRead = bytes / bytesPerSample;
+	if (samplesRead > count) {
+		samplesRead = count;
+	}
+
+	uint32_t used = samplesRead * bytesPerSample;
+	if (samplesRead > 0) {
+		oamlPcmBuffer::ToFloat(readBuffer.getRawData(), samples, samplesRead, bytesPerSample);
+	}
+
+	// Keep any trailing bytes of a partial sample for the next read
+	if (used < bytes) {
+		uint8_t rest[4];
+		memcpy(rest, readBuffer.getRawData() + used, bytes - used);
+		readBuffer.clear();
+		readBuffer.putBytes(rest, bytes - used);
+	} else {
+		readBuffer.clear();
+	}
+
+	return samplesRead;
+}
+
+unsigned int oamlStream::ReadHandle(float *samples, unsigned int count) {
+	if (resampler == NULL) {
+		unsigned int samplesRead = inputEnded ? 0 : ReadFile(samples, count);
+		filePos+= samplesRead;
+		return samplesRead;
+	}
+
+	unsigned int done = 0;
+	for (;;) {
+		done+= resampler->Read(samples + done, count - done);
+		if (done == count || inputEnded)
+			break;
+
+		// Needs more of the file to go on, its end lets the resampler flush what it holds
+		unsigned int samplesRead = ReadFile(&inputBuffer[0], (unsigned int)inputBuffer.size());
+		resampler->Write(&inputBuffer[0], samplesRead / channelCount);
+		if (inputEnded) {
+			resampler->End();
+		}
+	}
+
+	filePos+= done;
+	return done;
+}
+
+bool oamlStream::SeekHandle(unsigned int pos) {
+	if (handle == NULL) {
+		if (OpenHandle() == false)
+			return false;
+	}
+
+	// Jump to the frame holding pos, the samples of it before pos are read and dropped below
+	if (pos != filePos) {
+		unsigned int channels = handle->GetChannels();
+		unsigned int frame = channels > 0 ? pos / channels : 0;
+		if (resampler) {
+			// The resampler restarts at frame, the file a little before it for the filter's history
+			uint64_t fileFrame = resampler->Reset(frame);
+			if (handle->Seek((unsigned int)fileFrame) == 0) {
+				readBuffer.clear();
+				inputEnded = false;
+				filePos = frame * channels;
+			} else {
+				CloseHandle();
+				if (OpenHandle() == false)
+					return false;
+			}
+		} else if (handle->Seek(frame) == 0) {
+			readBuffer.clear();
+			inputEnded = false;
+			filePos = frame * channels;
+		}
+	}
+
+	// Formats that can't seek go back to the start, then read forward to pos
+	if (pos < filePos) {
+		CloseHandle();
+		if (OpenHandle() == false)
+			return false;
+	}
+
+	while (filePos < pos) {
+		unsigned int count = pos - filePos;
+		if (count > decodeBuffer.size()) {
+			count = (unsigned int)decodeBuffer.size();
+		}
+
+		if (ReadHandle(&decodeBuffer[0], count) == 0)
+			return false;
+	}
+
+	return true;
+}
+
+void oamlStream::Read(float *samples, unsigned int pos, unsigned int count, float gain, unsigned int resident) {
+	unsigned int end = pos + count;
+
+	if (pos != nextPos) {
+		// Whatever is before resident is played from the decoded head, so the streamer can start after it
+		seekPos.store(pos > resident ? pos : resident, std::memory_order_relaxed);
+		seekRequest.fetch_add(1, std::memory_order_release);
+	}
+	nextPos = end;
+
+	// The ring belongs to the streamer until it has handled the last seek
+	if (seekDone.load(std::memory_order_acquire) != seekRequest.load(std::memory_order_relaxed))
+		return;
+
+	unsigned int rpos = readPos.load(std::memory_order_relaxed);
+	unsigned int wpos = writePos.load(std::memory_order_acquire);
+
+	unsigned int start = pos;
+	if (start < rpos) start = rpos;
+	if (start < resident) start = resident;
+	unsigned int stop = end < wpos ? end : wpos;
+
+	// Anything not there yet is an underrun and plays as silence
+	size_t size = ring.size();
+	for (unsigned int p=start; p<stop; p++) {
+		samples[p - pos]+= ring[p % size] * gain;
+	}
+
+	if (stop > rpos) {
+		readPos.store(stop, std::memory_order_release);
+	}
+}
+
+bool oamlStream::Fill() {
+	if (failed)
+		return false;
+
+	// Nothing to do until the mixer tells us where to start
+	unsigned int request = seekRequest.load(std::memory_order_acquire);
+	if (request == 0)
+		return false;
+
+	bool busy = false;
+	if (request != seekDone.load(std::memory_order_relaxed)) {
+		unsigned int target = seekPos.load(std::memory_order_relaxed);
+		if (target > totalSamples) {
+			target = totalSamples;
+		}
+
+		if (target < totalSamples) {
+			SeekHandle(target);
+		}
+
+		readPos.store(target, std::memory_order_relaxed);
+		writePos.store(target, std::memory_order_relaxed);
+		seekDone.store(request, std::memory_order_release);
+		busy = true;
+	}
+
+	size_t size = ring.size();
+	for (;;) {
+		unsigned int rpos = readPos.load(std::memory_order_acquire);
+		unsigned int wpos = writePos.load(std::memory_order_relaxed);
+		if (wpos >= totalSamples)
+			break;
+
+		// Wait until there's room for a decent chunk instead of reading a few samples at a time
+		unsigned int space = (unsigned int)size - (wpos - rpos);
+		if (space < decodeBuffer.size() && space < totalSamples - wpos)
+			break;
+
+		if (handle == NULL || filePos != wpos) {
+			if (SeekHandle(wpos) == false) {
+				// The file is shorter than its header said, don't keep reopening it
+				totalSamples = wpos;
+				break;
+			}
+		}
+
+		unsigned int count = space;
+		if (count > decodeBuffer.size()) count = (unsigned int)decodeBuffer.size();
+		if (count > totalSamples - wpos) count = totalSamples - wpos;
+
+		count = ReadHandle(&decodeBuffer[0], count);
+		if (count == 0) {
+			totalSamples = wpos;
+			break;
+		}
+
+		for (unsigned int i=0; i<count; i++) {
+			ring[(wpos + i) % size] = decodeBuffer[i];
+		}
+
+		writePos.store(wpos + count, std::memory_order_release);
+		busy = true;
+	}
+
+	return busy;
+}
+
+size_t oamlStream::GetMemorySize() const {
+	return ring.capacity() * sizeof(float) + (decodeBuffer.capacity() + inputBuffer.capacity()) * sizeof(float);
+}
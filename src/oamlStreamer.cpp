@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+oamlStreamer::oamlStreamer() {
+	quit = false;
+}
+
+oamlStreamer::~oamlStreamer() {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+		quit = true;
+	}
+
+	wake.notify_all();
+	if (thread.joinable()) {
+		thread.join();
+	}
+
+	for (std::vector<oamlStream*>::iterator it=streams.begin(); it<streams.end(); ++it) {
+		delete *it;
+	}
+	streams.clear();
+}
+
+void oamlStreamer::Add(oamlStream *stream) {
+	{
+		std::lock_guard<std::mutex> guard(mutex);
+
+		streams.push_back(stream);
+
+		// Only start the thread once something actually streams
+		if (thread.joinable() == false) {
+			thread = std::thread(&oamlStreamer::StreamerThread, this);
+		}
+	}
+
+	wake.notify_one();
+}
+
+size_t oamlStreamer::GetMemoryUsage() {
+	std::lock_guard<std::mutex> guard(mutex);
+
+	size_t total = 0;
+	for (std::vector<oamlStream*>::iterator it=streams.begin(); it<streams.end(); ++it) {
+		total+= (*it)->GetMemorySize();
+	}
+
+	return total;
+}
+
+void oamlStreamer::StreamerThread() {
+	std::vector<oamlStream*> active;
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (quit == false) {
+		active.clear();
+		for (std::vector<oamlStream*>::iterator it=streams.begin(); it<streams.end();) {
+			oamlStream *stream = *it;
+			if (stream->IsClosed()) {
+				delete stream;
+				it = streams.erase(it);
+			} else {
+				active.push_back(stream);
+				++it;
+			}
+		}
+
+		// Don't hold the lock while reading from disk, Add() is called from the mixer
+		lock.unlock();
+
+		bool busy = false;
+		for (std::vector<oamlStream*>::iterator it=active.begin(); it<active.end(); ++it) {
+			if ((*it)->Fill()) {
+				busy = true;
+			}
+		}
+
+		lock.lock();
+
+		// Rings hold half a second, so polling every few ms is plenty to catch up after a seek
+		if (busy == false && quit == false) {
+			wake.wait_for(lock, std::chrono::milliseconds(5));
+		}
+	}
+}
@@ -29,7 +29,6 @@
 
 oamlTrack::oamlTrack() {
 	name = "Track";
-	lock = 0;
 	volume = 1.f;
 
 	fadeIn = 0;
@@ -50,18 +49,44 @@ void oamlTrack::ClearAudios(std::vector<oamlAudio*> *audios) {
 	}
 }
 
-oamlAudio* oamlTrack::FindAudio(std::vector<oamlAudio*> *audios, std::string audioName) {
+void oamlTrack::IndexAudio(oamlAudio *audio) {
+	// Doesn't replace an audio already using the name
+	audioIndex.insert(std::make_pair(audio->GetName(), audio));
+}
+
+void oamlTrack::IndexAudios(std::vector<oamlAudio*> *audios) {
 	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
-		oamlAudio *audio = *it;
-		if (audio->GetName() == audioName) {
-			return audio;
-		}
+		IndexAudio(*it);
+	}
+}
+
+oamlAudio* oamlTrack::GetAudio(const std::string& audioName) const {
+	std::unordered_map<std::string, oamlAudio*>::const_iterator it = audioIndex.find(audioName);
+	if (it == audioIndex.end())
+		return NULL;
+
+	return it->second;
+}
+
+bool oamlTrack::HasGroup(const char *trackGroup) const {
+	for (std::vector<std::string>::const_iterator it=groups.begin(); it<groups.end(); ++it) {
+		if (it->compare(trackGroup) == 0)
+			return true;
 	}
 
-	return NULL;
+	return false;
 }
 
-oamlRC oamlTrack::FindAudioAndRemove(std::vector<oamlAudio*> *audios, std::string audioName) {
+bool oamlTrack::HasSubgroup(const char *trackSubgroup) const {
+	for (std::vector<std::string>::const_iterator it=subgroups.begin(); it<subgroups.end(); ++it) {
+		if (it->compare(trackSubgroup) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+oamlRC oamlTrack::FindAudioAndRemove(std::vector<oamlAudio*> *audios, const std::string& audioName) {
 	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
 		oamlAudio *audio = *it;
 		if (audio->GetName() == audioName) {
@@ -73,10 +98,31 @@ oamlRC oamlTrack::FindAudioAndRemove(std::vector<oamlAudio*> *audios, std::strin
 	return OAML_NOT_FOUND;
 }
 
-void oamlTrack::FreeAudiosMemory(std::vector<oamlAudio*> *audios) {
+void oamlTrack::ReleaseAudios(std::vector<oamlAudio*> *audios) {
 	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
 		oamlAudio *audio = *it;
-		audio->FreeMemory();
+		audio->Release();
+	}
+}
+
+oamlRC oamlTrack::PrepareAudios(std::vector<oamlAudio*> *audios) {
+	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
+		oamlRC rc = (*it)->Prepare();
+		if (rc != OAML_OK) {
+			// Leave nothing prepared behind on failure
+			for (std::vector<oamlAudio*>::iterator prev=audios->begin(); prev<it; ++prev) {
+				(*prev)->Unprepare();
+			}
+			return rc;
+		}
+	}
+
+	return OAML_OK;
+}
+
+void oamlTrack::UnprepareAudios(std::vector<oamlAudio*> *audios) {
+	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
+		(*it)->Unprepare();
 	}
 }
 
@@ -101,26 +147,32 @@ void oamlTrack::ShowPlaying() {
 	}
 }
 
-void oamlTrack::ApplyVolPanTo(float *samples, int channels, float vol, float pan) {
+void oamlTrack::ApplyVolPanTo(float *samples, int frames, int channels, float vol, float pan) {
+	float left = vol;
+	float right = vol;
+
 	if (channels == 2) {
 		// Stereo output, apply panning
-
 		if (pan < 0.f) {
-			samples[0] = samples[0];
-			samples[1] = samples[1] * (1.f + pan);
+			right*= 1.f + pan;
 		} else if (pan > 0.f) {
-			samples[0] = samples[0] * (1.f - pan);
-			samples[1] = samples[1];
+			left*= 1.f - pan;
 		}
-	}
 
-	// Apply volume
-	for (int i=0; i<channels; i++) {
-		samples[i] = samples[i] * vol;
+		for (int i=0; i<frames*2; i+= 2) {
+			samples[i+0]*= left;
+			samples[i+1]*= right;
+		}
+	} else {
+		// Apply volume
+		for (int i=0; i<frames*channels; i++) {
+			samples[i]*= vol;
+		}
 	}
 }
 
-float oamlTrack::SafeAdd(float a, float b, bool debug) {
+template <bool CHECK_CLIPPING>
+float oamlTrack::SafeAdd(float a, float b) {
 	float r = a + b;
 	bool clipping = false;
 
@@ -132,7 +184,7 @@ float oamlTrack::SafeAdd(float a, float b, bool debug) {
 		clipping = true;
 	}
 
-	if (clipping && debug) {
+	if (CHECK_CLIPPING && clipping) {
 		fprintf(stderr, "oaml: Detected clipping!\n");
 		ShowPlaying();
 	}
@@ -140,23 +192,45 @@ float oamlTrack::SafeAdd(float a, float b, bool debug) {
 	return r;
 }
 
-void oamlTrack::MixAudio(oamlAudio *audio, float *samples, int channels, bool debug) {
-	float buf[8];
-
-	audio->ReadSamples(buf, channels);
-	for (int i=0; i<channels; i++) {
-		samples[i] = SafeAdd(samples[i], buf[i] * volume, debug);
+template <bool CHECK_CLIPPING>
+void oamlTrack::AddSamples(float *samples, const float *buf, int size, float vol) {
+	for (int i=0; i<size; i++) {
+		samples[i] = SafeAdd<CHECK_CLIPPING>(samples[i], buf[i] * vol);
 	}
 }
 
-unsigned int oamlTrack::MixAudio(oamlAudio *audio, float *samples, int channels, bool debug, unsigned int pos) {
-	float buf[8];
+void oamlTrack::AddSamples(float *samples, const float *buf, int size, float vol, bool debug) {
+	// Checked once per block, the loop itself is built with and without the clipping report
+	if (debug) {
+		AddSamples<true>(samples, buf, size, vol);
+	} else {
+		AddSamples<false>(samples, buf, size, vol);
+	}
+}
 
-	pos = audio->ReadSamples(buf, channels, pos);
-	for (int i=0; i<channels; i++) {
-		samples[i] = SafeAdd(samples[i], buf[i] * volume, debug);
+float *oamlTrack::GetAudioBuffer(int size) {
+	if ((int)audioBuffer.size() < size) {
+		audioBuffer.resize(size);
 	}
 
+	return &audioBuffer[0];
+}
+
+void oamlTrack::MixAudio(oamlAudio *audio, float *samples, int frames, int channels, bool debug) {
+	int size = frames * channels;
+	float *buf = GetAudioBuffer(size);
+
+	audio->ReadSamples(buf, frames, channels);
+	AddSamples(samples, buf, size, volume, debug);
+}
+
+unsigned int oamlTrack::MixAudio(oamlAudio *audio, float *samples, int frames, int channels, bool debug, unsigned int pos) {
+	int size = frames * channels;
+	float *buf = GetAudioBuffer(size);
+
+	pos = audio->ReadSamples(buf, frames, channels, pos);
+	AddSamples(samples, buf, size, volume, debug);
+
 	return pos;
 }
 
@@ -183,34 +257,29 @@ void oamlTrack::ReadAudiosInfo(std::vector<oamlAudio*> *audios, oamlTrackInfo *i
 	}
 }
 
-int oamlTrack::GetFilesSamplesFor(std::vector<oamlAudio*> *audios) {
-	int total = 0;
-
+void oamlTrack::FillAudioFilesList(std::vector<oamlAudio*> *audios, std::vector<oamlAudioFile*>& list) {
 	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
 		oamlAudio *audio = *it;
-
-		int samples = audio->GetFilesSamples();
-		if (samples == -1)
-			return -1;
-
-		total+= samples;
+		audio->GetAudioFiles(list);
 	}
-
-	return total;
 }
 
-int oamlTrack::LoadProgressFor(std::vector<oamlAudio*> *audios) {
-	int ret = 0;
+float oamlTrack::LoadProgress() {
+	std::vector<oamlAudioFile*> list;
+	GetAudioFiles(list);
 
-	for (std::vector<oamlAudio*>::iterator it=audios->begin(); it<audios->end(); ++it) {
-		oamlAudio *audio = *it;
+	if (list.empty())
+		return -1.f;
 
-		int samples = audio->LoadProgress();
-		if (samples == -1)
-			return -1;
+	// Loading itself is done by the loader threads, here we only add up how far each file got
+	double progress = 0.0;
+	for (std::vector<oamlAudioFile*>::iterator it=list.begin(); it<list.end(); ++it) {
+		float fileProgress = (*it)->LoadProgress();
+		if (fileProgress < 0.f)
+			return -1.f;
 
-		ret+= samples;
+		progress+= fileProgress;
 	}
 
-	return ret;
+	return float(progress / list.size());
 }
@@ -36,6 +36,11 @@ float __oamlInteger24ToFloat(int i) {
 	return (i + 0.5f) * Q;
 }
 
+float __oamlInteger32ToFloat(int i) {
+	const double Q = 1.0 / (0x7fffffff + 0.5);
+	return (float)((i + 0.5) * Q);
+}
+
 int __oamlFloatToInteger24(float f) {
 	return ((int)(f * 8388608) & 0x00ffffff);
 }
@@ -32,37 +32,47 @@
 
 static size_t oggFile_read(void *ptr, size_t size, size_t nmemb, void *datasource) {
 	oggFile *ogg = (oggFile*)datasource;
-	return ogg->GetFileCallbacks()->read(ptr, size, nmemb, ogg->GetFD());
+	return ogg->ReadSource(ptr, size, nmemb);
 }
 
 static int oggFile_seek(void *datasource, ogg_int64_t offset, int whence) {
 	oggFile *ogg = (oggFile*)datasource;
-	return ogg->GetFileCallbacks()->seek(ogg->GetFD(), offset, whence);
+	return ogg->SeekSource((long)offset, whence);
 }
 
 int oggFile_close(void *datasource) {
 	oggFile *ogg = (oggFile*)datasource;
+	if (ogg->GetFD() == NULL)
+		return 0;
+
 	return ogg->GetFileCallbacks()->close(ogg->GetFD());
 }
 
 long oggFile_tell(void *datasource) {
 	oggFile *ogg = (oggFile*)datasource;
-	return ogg->GetFileCallbacks()->tell(ogg->GetFD());
+	return ogg->TellSource();
 }
 
-oggFile::oggFile(oamlFileCallbacks *cbs) : audioFile(cbs) {
+oggFile::oggFile(oamlFileCallbacks2 *cbs) : audioFile(cbs) {
 	fcbs = cbs;
 	fd = NULL;
+	vf = NULL;
 
 	format = 0;
 	channels = 0;
 	samplesPerSec = 0;
 	bitsPerSample = 0;
 	totalSamples = 0;
+
+	currentSection = 0;
+	pendingPos = 0;
+
+	memData = NULL;
+	memPos = 0;
 }
 
 oggFile::~oggFile() {
-	if (fd != NULL) {
+	if (fd != NULL || vf != NULL) {
 		Close();
 	}
 }
@@ -70,14 +80,29 @@ oggFile::~oggFile() {
 int oggFile::Open(const char *filename) {
 	ASSERT(filename != NULL);
 
-	if (fd != NULL) {
+	if (fd != NULL || vf != NULL) {
 		Close();
 	}
 
-	fd = fcbs->open(filename);
-	if (fd == NULL) {
-		printf("Error opening '%s'\n", filename);
-		return -1;
+	memData = NULL;
+	memPos = 0;
+
+	if (source) {
+		// Already in memory, there's no file to open
+		memData = source->GetData();
+		dataSize = (unsigned int)source->GetSize();
+	} else {
+		fd = fcbs->open(filename);
+		if (fd == NULL) {
+			printf("Error opening '%s'\n", filename);
+			return -1;
+		}
+
+		// Decode straight from memory if the whole file can be mapped
+		if (MapFile()) {
+			memData = mapped->GetData();
+			dataSize = (unsigned int)mapped->GetSize();
+		}
 	}
 
 	OggVorbis_File *ovf = new OggVorbis_File;
@@ -102,7 +127,8 @@ int oggFile::Open(const char *filename) {
 
 	channels = vi->channels;
 	samplesPerSec = vi->rate;
-	bitsPerSample = 16;
+	// Vorbis decodes to float, handing it out as such saves a round trip through 16 bits
+	bitsPerSample = 32;
 	totalSamples = (int)ov_pcm_total(ovf, -1) * channels;
 
 	vf = (void*)ovf;
@@ -110,31 +136,131 @@ int oggFile::Open(const char *filename) {
 	return 0;
 }
 
+size_t oggFile::ReadSource(void *ptr, size_t size, size_t nmemb) {
+	if (memData == NULL) {
+		return fcbs->read(ptr, size, nmemb, fd);
+	}
+
+	if (size == 0 || memPos >= dataSize)
+		return 0;
+
+	size_t items = (dataSize - memPos) / size;
+	if (items > nmemb) {
+		items = nmemb;
+	}
+
+	memcpy(ptr, memData + memPos, items * size);
+	memPos+= items * size;
+	return items;
+}
+
+int oggFile::SeekSource(long offset, int whence) {
+	if (memData == NULL) {
+		return fcbs->seek(fd, offset, whence);
+	}
+
+	long pos;
+	switch (whence) {
+		case SEEK_SET: pos = offset; break;
+		case SEEK_CUR: pos = (long)memPos + offset; break;
+		case SEEK_END: pos = (long)dataSize + offset; break;
+		default: return -1;
+	}
+
+	if (pos < 0 || pos > (long)dataSize)
+		return -1;
+
+	memPos = (size_t)pos;
+	return 0;
+}
+
+long oggFile::TellSource() {
+	if (memData == NULL) {
+		return fcbs->tell(fd);
+	}
+
+	return (long)memPos;
+}
+
 int oggFile::Read(ByteBuffer *buffer, int size) {
-	unsigned char buf[4096];
+	float buf[1024];
 
 	if (vf == NULL)
 		return -1;
 
-	OggVorbis_File *ovf = (OggVorbis_File *)vf;
-
 	int bytesRead = 0;
 	while (size > 0) {
-		// Let's keep reading data!
-		int bytes = size < 4096 ? size : 4096;
-		int ret = (int)ov_read(ovf, (char*)buf, bytes, 0, 2, 1, &currentSection);
-		if (ret == 0) {
+		int count = size / (int)sizeof(float);
+		if (count > 1024) count = 1024;
+		if (count == 0)
 			break;
-		} else {
-			buffer->putBytes(buf, ret);
-			bytesRead+= ret;
-			size-= ret;
-		}
+
+		int ret = ReadFloat(buf, count);
+		if (ret <= 0)
+			break;
+
+		int bytes = ret * (int)sizeof(float);
+		buffer->putBytes((uint8_t*)buf, bytes);
+		bytesRead+= bytes;
+		size-= bytes;
 	}
 
 	return bytesRead;
 }
 
+int oggFile::ReadFloat(float *samples, int count) {
+	if (vf == NULL)
+		return -1;
+
+	OggVorbis_File *ovf = (OggVorbis_File *)vf;
+
+	int samplesRead = 0;
+	while (samplesRead < count && pendingPos < pending.size()) {
+		samples[samplesRead++] = pending[pendingPos++];
+	}
+
+	while (samplesRead < count) {
+		float **pcm;
+		int frames = (count - samplesRead + channels - 1) / channels;
+		long ret = ov_read_float(ovf, &pcm, frames, &currentSection);
+		if (ret == OV_HOLE) {
+			continue;
+		} else if (ret < 0) {
+			return samplesRead > 0 ? samplesRead : -1;
+		} else if (ret == 0) {
+			break;
+		}
+
+		// vorbisfile hands out one buffer per channel, interleave them as we go
+		pending.clear();
+		pendingPos = 0;
+		for (long i=0; i<ret; i++) {
+			for (int c=0; c<channels; c++) {
+				if (samplesRead < count) {
+					samples[samplesRead++] = pcm[c][i];
+				} else {
+					pending.push_back(pcm[c][i]);
+				}
+			}
+		}
+	}
+
+	return samplesRead;
+}
+
+int oggFile::Seek(unsigned int frame) {
+	if (vf == NULL)
+		return -1;
+
+	OggVorbis_File *ovf = (OggVorbis_File *)vf;
+	if (ov_pcm_seek(ovf, (ogg_int64_t)frame) != 0)
+		return -1;
+
+	pending.clear();
+	pendingPos = 0;
+	return 0;
+}
+
 void oggFile::WriteToFile(const char *, ByteBuffer *, int, unsigned int, int) {
 }
 
@@ -144,5 +270,9 @@ void oggFile::Close() {
 		ov_clear(ovf);
 		delete ovf;
 		vf = NULL;
+		fd = NULL;
+
+		pending.clear();
+		pendingPos = 0;
 	}
 }
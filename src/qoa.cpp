@@ -0,0 +1,303 @@
+//-----------------------------------------------------------------------------
+// Copyright (c) 2015-2016 Marcelo Fernandez
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "oamlCommon.h"
+
+
+// round(scalefactor * { 0.75, -0.75, 2.5, -2.5, 4.5, -4.5, 7, -7 }) with scalefactor = round((s + 1) ^ 2.75)
+static const int qoaDequantTab[16][8] = {
+	{1, -1, 3, -3, 5, -5, 7, -7},
+	{5, -5, 18, -18, 32, -32, 49, -49},
+	{16, -16, 53, -53, 95, -95, 147, -147},
+	{34, -34, 113, -113, 203, -203, 315, -315},
+	{63, -63, 210, -210, 378, -378, 588, -588},
+	{104, -104, 345, -345, 621, -621, 966, -966},
+	{158, -158, 528, -528, 950, -950, 1477, -1477},
+	{228, -228, 760, -760, 1368, -1368, 2128, -2128},
+	{316, -316, 1053, -1053, 1895, -1895, 2947, -2947},
+	{422, -422, 1405, -1405, 2529, -2529, 3934, -3934},
+	{548, -548, 1828, -1828, 3290, -3290, 5117, -5117},
+	{696, -696, 2320, -2320, 4176, -4176, 6496, -6496},
+	{868, -868, 2893, -2893, 5207, -5207, 8099, -8099},
+	{1064, -1064, 3548, -3548, 6386, -6386, 9933, -9933},
+	{1286, -1286, 4288, -4288, 7718, -7718, 12005, -12005},
+	{1536, -1536, 5120, -5120, 9216, -9216, 14336, -14336}
+};
+
+static uint64_t qoaReadU64(const uint8_t *p) {
+	// Everything in a qoa file is big endian
+	return ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) | ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+		((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) | ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+}
+
+qoaFile::qoaFile(oamlFileCallbacks2 *cbs) : audioFile(cbs) {
+	fd = NULL;
+
+	channels = 0;
+	samplesPerSec = 0;
+	totalSamples = 0;
+
+	memData = NULL;
+	memPos = 0;
+
+	frameSize = 0;
+	framePos = 0;
+}
+
+qoaFile::~qoaFile() {
+	Close();
+}
+
+int qoaFile::Open(const char *filename) {
+	ASSERT(filename != NULL);
+
+	Close();
+
+	if (source) {
+		// Already in memory, there's no file to open
+		memData = source->GetData();
+		dataSize = (unsigned int)source->GetSize();
+	} else {
+		fd = fcbs->open(filename);
+		if (fd == NULL) {
+			return -1;
+		}
+
+		// Decode straight from memory if the whole file can be mapped
+		if (MapFile()) {
+			memData = mapped->GetData();
+			dataSize = (unsigned int)mapped->GetSize();
+		}
+	}
+
+	// File header and the first frame header, which is where channels and rate are
+	uint8_t header[16];
+	if (ReadData(header, 16) != 16 || memcmp(header, "qoaf", 4) != 0) {
+		fprintf(stderr, "liboaml: Not a qoa file: '%s'\n", filename);
+		return -1;
+	}
+
+	unsigned int frames = (header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7];
+	if (frames == 0) {
+		fprintf(stderr, "liboaml: Streamed qoa files of unknown length aren't supported: '%s'\n", filename);
+		return -1;
+	}
+
+	channels = header[8];
+	samplesPerSec = (header[9] << 16) | (header[10] << 8) | header[11];
+	if (channels == 0 || channels > QOA_MAX_CHANNELS || samplesPerSec == 0) {
+		fprintf(stderr, "liboaml: Invalid qoa file: '%s'\n", filename);
+		return -1;
+	}
+
+	totalSamples = frames * channels;
+
+	if (SeekData(8) == false)
+		return -1;
+
+	return 0;
+}
+
+size_t qoaFile::ReadData(void *ptr, size_t bytes) {
+	if (memData == NULL) {
+		return ReadBytes(ptr, bytes);
+	}
+
+	if (memPos >= dataSize)
+		return 0;
+
+	if (bytes > dataSize - memPos) {
+		bytes = dataSize - memPos;
+	}
+
+	memcpy(ptr, memData + memPos, bytes);
+	memPos+= bytes;
+	return bytes;
+}
+
+bool qoaFile::SeekData(size_t offset) {
+	if (memData == NULL) {
+		return fcbs->seek(fd, (long)offset, SEEK_SET) == 0;
+	}
+
+	if (offset > dataSize)
+		return false;
+
+	memPos = offset;
+	return true;
+}
+
+int qoaFile::DecodeFrame() {
+	framePos = 0;
+	frameSize = 0;
+
+	uint8_t header[8];
+	if (ReadData(header, 8) != 8)
+		return 0;
+
+	int frameChannels = header[0];
+	int frameRate = (header[1] << 16) | (header[2] << 8) | header[3];
+	unsigned int samples = (header[4] << 8) | header[5];
+	unsigned int size = (header[6] << 8) | header[7];
+
+	// Every frame has its predictor state (4 history and 4 weights per channel) followed by the slices
+	unsigned int lmsSize = 16 * channels;
+	if (frameChannels != channels || frameRate != samplesPerSec || size < 8 + lmsSize)
+		return -1;
+
+	unsigned int slices = (size - 8 - lmsSize) / 8;
+	if (((samples + QOA_SLICE_LEN - 1) / QOA_SLICE_LEN) * channels > slices)
+		return -1;
+
+	frameData.resize(size - 8);
+	if (ReadData(&frameData[0], size - 8) != size - 8)
+		return -1;
+
+	const uint8_t *p = &frameData[0];
+	int history[QOA_MAX_CHANNELS][4];
+	int weights[QOA_MAX_CHANNELS][4];
+	for (int c=0; c<channels; c++) {
+		uint64_t h = qoaReadU64(p);
+		uint64_t w = qoaReadU64(p + 8);
+		p+= 16;
+
+		for (int i=0; i<4; i++) {
+			history[c][i] = (int16_t)(h >> 48);
+			weights[c][i] = (int16_t)(w >> 48);
+			h<<= 16;
+			w<<= 16;
+		}
+	}
+
+	frameSamples.resize(samples * channels);
+	int16_t *dst = frameSamples.empty() ? NULL : &frameSamples[0];
+
+	// Slices of 20 samples, interleaved by channel
+	for (unsigned int start=0; start<samples; start+= QOA_SLICE_LEN) {
+		unsigned int end = start + QOA_SLICE_LEN < samples ? start + QOA_SLICE_LEN : samples;
+
+		for (int c=0; c<channels; c++) {
+			uint64_t slice = qoaReadU64(p);
+			p+= 8;
+
+			const int *dequant = qoaDequantTab[(slice >> 60) & 0xf];
+			slice<<= 4;
+
+			int *hist = history[c];
+			int *weight = weights[c];
+			for (unsigned int i=start; i<end; i++) {
+				int predicted = (weight[0] * hist[0] + weight[1] * hist[1] + weight[2] * hist[2] + weight[3] * hist[3]) >> 13;
+				int dequantized = dequant[(slice >> 61) & 0x7];
+				slice<<= 3;
+
+				int sample = predicted + dequantized;
+				if (sample < -32768) sample = -32768;
+				else if (sample > 32767) sample = 32767;
+				dst[i * channels + c] = (int16_t)sample;
+
+				// Sign-sign LMS, nudge the weights towards the sign of each history sample
+				int delta = dequantized >> 4;
+				for (int k=0; k<4; k++) {
+					weight[k]+= hist[k] < 0 ? -delta : delta;
+				}
+
+				hist[0] = hist[1];
+				hist[1] = hist[2];
+				hist[2] = hist[3];
+				hist[3] = sample;
+			}
+		}
+	}
+
+	frameSize = samples * channels;
+	return (int)frameSize;
+}
+
+int qoaFile::Read(ByteBuffer *buffer, int size) {
+	if (fd == NULL && memData == NULL)
+		return -1;
+
+	int bytesRead = 0;
+	while (size >= 2) {
+		if (framePos >= frameSize) {
+			int ret = DecodeFrame();
+			if (ret < 0) {
+				return bytesRead > 0 ? bytesRead : -1;
+			} else if (ret == 0) {
+				break;
+			}
+		}
+
+		unsigned int count = frameSize - framePos;
+		if (count > (unsigned int)size / 2) {
+			count = size / 2;
+		}
+
+		buffer->putBytes((uint8_t*)&frameSamples[framePos], count * 2);
+		framePos+= count;
+		bytesRead+= count * 2;
+		size-= count * 2;
+	}
+
+	return bytesRead;
+}
+
+int qoaFile::Seek(unsigned int frame) {
+	if (fd == NULL && memData == NULL)
+		return -1;
+
+	// All frames but the last are full, so a frame starts at a fixed offset
+	unsigned int index = frame / QOA_FRAME_LEN;
+	size_t fullFrameSize = 8 + 16 * channels + QOA_SLICES_PER_FRAME * 8 * channels;
+	if (SeekData(8 + index * fullFrameSize) == false)
+		return -1;
+
+	if (DecodeFrame() < 0)
+		return -1;
+
+	framePos = (frame % QOA_FRAME_LEN) * channels;
+	if (framePos > frameSize) {
+		framePos = frameSize;
+	}
+
+	return 0;
+}
+
+void qoaFile::WriteToFile(const char *, ByteBuffer *, int, unsigned int, int) {
+}
+
+void qoaFile::Close() {
+	if (fd != NULL) {
+		fcbs->close(fd);
+		fd = NULL;
+	}
+
+	memData = NULL;
+	memPos = 0;
+
+	frameSize = 0;
+	framePos = 0;
+}
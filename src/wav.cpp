@@ -36,6 +36,12 @@ enum {
 	BEXT_ID = 0x74786562
 };
 
+enum {
+	WAVE_FORMAT_PCM		= 0x0001,
+	WAVE_FORMAT_IEEE_FLOAT	= 0x0003,
+	WAVE_FORMAT_EXTENSIBLE	= 0xFFFE
+};
+
 typedef struct {
 	int id;
 	unsigned int size;
@@ -57,7 +63,7 @@ typedef struct {
 } fmtHeader;
 
 
-wavFile::wavFile(oamlFileCallbacks *cbs) : audioFile(cbs) {
+wavFile::wavFile(oamlFileCallbacks2 *cbs) : audioFile(cbs) {
 	fcbs = cbs;
 	fd = NULL;
 
@@ -95,9 +101,37 @@ int wavFile::Open(const char *filename) {
 		}
 	}
 
+	if (GetPcmFormat() == OAML_PCM_NONE) {
+		fprintf(stderr, "liboaml: Unsupported wav format %d (%d bits): '%s'\n", format, bitsPerSample, filename);
+		return -1;
+	}
+
+	// Read the data straight from memory when we can
+	if (GetPcmFormat() != OAML_PCM_NONE && MapFile()) {
+		chunkSize = dataSize;
+		totalSamples = chunkSize / (bitsPerSample/8);
+	}
+
 	return 0;
 }
 
+int wavFile::GetPcmFormat() const {
+	if (format == WAVE_FORMAT_IEEE_FLOAT)
+		return bitsPerSample == 32 ? OAML_PCM_F32LE : OAML_PCM_NONE;
+
+	if (format != WAVE_FORMAT_PCM)
+		return OAML_PCM_NONE;
+
+	switch (bitsPerSample) {
+		case 8: return OAML_PCM_U8;
+		case 16: return OAML_PCM_S16LE;
+		case 24: return OAML_PCM_S24LE;
+		case 32: return OAML_PCM_S32LE;
+	}
+
+	return OAML_PCM_NONE;
+}
+
 int wavFile::ReadChunk() {
 	if (fd == NULL)
 		return -1;
@@ -126,10 +160,25 @@ int wavFile::ReadChunk() {
 			if (fcbs->read(&fmt, 1, sizeof(fmtHeader), fd) != sizeof(fmtHeader))
 				return -1;
 
+			format = fmt.formatTag;
+
 			if (header.size > sizeof(fmtHeader)) {
-				fcbs->seek(fd, header.size - sizeof(fmtHeader), SEEK_CUR);
+				unsigned int extra = header.size - sizeof(fmtHeader);
+
+				// Extensible files have the actual format tag at the start of their sub format guid
+				uint8_t ext[10];
+				if (format == WAVE_FORMAT_EXTENSIBLE && extra >= sizeof(ext)) {
+					if (fcbs->read(ext, 1, sizeof(ext), fd) != sizeof(ext))
+						return -1;
+
+					format = ext[8] | (ext[9] << 8);
+					extra-= sizeof(ext);
+				}
+
+				if (extra > 0) {
+					fcbs->seek(fd, extra, SEEK_CUR);
+				}
 			}
-			format = fmt.formatTag;
 			channels = fmt.channels;
 			samplesPerSec = fmt.samplesPerSec;
 			bitsPerSample = fmt.bitsPerSample;
@@ -137,6 +186,8 @@ int wavFile::ReadChunk() {
 			break;
 
 		case DATA_ID:
+			dataOffset = (unsigned int)fcbs->tell(fd);
+			dataSize = header.size;
 			chunkSize = header.size;
 			totalSamples = chunkSize / (bitsPerSample/8);
 			status = 2;
@@ -150,12 +201,47 @@ int wavFile::ReadChunk() {
 	return 0;
 }
 
+void wavFile::ConvertData(unsigned char *buf, int size) {
+	// 32 bit integer data is handed out as float, like float files are
+	if (GetPcmFormat() == OAML_PCM_S32LE) {
+		for (int i=0; i+4<=size; i+= 4) {
+			int32_t value;
+			memcpy(&value, buf + i, 4);
+			float f = __oamlInteger32ToFloat(value);
+			memcpy(buf + i, &f, 4);
+		}
+	}
+}
+
 int wavFile::Read(ByteBuffer *buffer, int size) {
 	unsigned char buf[4096];
 
 	if (fd == NULL)
 		return -1;
 
+	if (mapped) {
+		// Mapped files are copied once, straight from the mapping
+		int bytes = size < chunkSize ? size : chunkSize;
+		if (bytes <= 0) {
+			status = 3;
+			return 0;
+		}
+
+		const uint8_t *src = mapped->GetData() + dataOffset + (dataSize - chunkSize);
+		if (GetPcmFormat() == OAML_PCM_S32LE) {
+			for (int i=0; i<bytes; i+= 4096) {
+				int n = bytes - i < 4096 ? bytes - i : 4096;
+				memcpy(buf, src + i, n);
+				ConvertData(buf, n);
+				buffer->putBytes(buf, n);
+			}
+		} else {
+			buffer->putBytes((uint8_t*)src, bytes);
+		}
+		chunkSize-= bytes;
+		return bytes;
+	}
+
 	int bytesRead = 0;
 	while (size > 0) {
 		// Are we inside a data chunk?
@@ -164,12 +250,15 @@ int wavFile::Read(ByteBuffer *buffer, int size) {
 			int bytes = size < 4096 ? size : 4096;
 			if (chunkSize < bytes)
 				bytes = chunkSize;
-			int ret = fcbs->read(buf, 1, bytes, fd);
+			int ret = (int)ReadBytes(buf, bytes);
 			if (ret == 0) {
 				status = 3;
 				break;
 			} else {
 				chunkSize-= ret;
+
+				ConvertData(buf, ret);
+
 				buffer->putBytes(buf, ret);
 				bytesRead+= ret;
 				size-= ret;
@@ -183,6 +272,24 @@ int wavFile::Read(ByteBuffer *buffer, int size) {
 	return bytesRead;
 }
 
+int wavFile::Seek(unsigned int frame) {
+	if (fd == NULL || status < 2)
+		return -1;
+
+	unsigned int offset = frame * channels * (bitsPerSample/8);
+	if (offset > dataSize) {
+		offset = dataSize;
+	}
+
+	// Mapped files read from dataOffset + (dataSize - chunkSize), only the file needs moving
+	if (mapped == NULL && fcbs->seek(fd, dataOffset + offset, SEEK_SET) != 0)
+		return -1;
+
+	chunkSize = dataSize - offset;
+	status = 2;
+	return 0;
+}
+
 void wavFile::WriteToFile(const char *filename, ByteBuffer *buffer, int channels, unsigned int sampleRate, int bytesPerSample) {
 	ASSERT(filename != NULL);
 	ASSERT(buffer != NULL);